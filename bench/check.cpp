@@ -0,0 +1,365 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "log.hpp"
+#include "netascii.hpp"
+#include "sequence.hpp"
+#include "server.hpp"
+#include "tftpclient.hpp"
+
+// Randomized checks of the optimized code against simple reference implementations.
+// Seeds are fixed, so a failure repeats on every run
+
+#define SCAN_ROUNDS 200000
+#define SCAN_MAX_LENGTH 300
+#define SCAN_MAX_ALIGNMENT 64
+#define CODEC_ROUNDS 20000
+#define CODEC_MAX_LENGTH 2000
+#define CODEC_MAX_BLOCK 600
+#define ROLLOVER_BLOCKS 70000 // Past the wrap of 16-bit block numbers
+#define ROLLOVER_BLOCK_SIZE 8
+#define SEQUENCE_ROUNDS 300
+#define SEQUENCE_ARRIVALS 5000
+
+bool report(const std::string &name, bool passed, const std::string &detail = "");
+bool checkScanKernels();
+std::string randomNetascii(std::mt19937 &random, size_t length, int density);
+std::string referenceEncode(const std::string &data);
+std::string streamEncode(std::mt19937 &random, const std::string &data, size_t blockSize);
+std::string streamDecode(std::mt19937 &random, const std::string &encoded, size_t maxBlockSize);
+bool checkNetasciiCodec();
+bool checkBlockNumbers();
+bool checkRolloverTransfers();
+bool checkSequenceTracker();
+
+class MemorySink : public Sink
+{
+public:
+    std::string data;
+    void write(size_t offset, const char *buffer, size_t length) override
+    {
+        if (data.size() < offset + length)
+        {
+            data.resize(offset + length);
+        }
+        memcpy(data.data() + offset, buffer, length);
+    }
+};
+
+class MemorySource : public Source
+{
+    const std::string &content;
+    size_t position = 0;
+
+public:
+    MemorySource(const std::string &content) : content(content) {}
+    size_t size() override { return content.size(); }
+    int read(char *buffer, int length) override
+    {
+        size_t count = std::min<size_t>(length, content.size() - position);
+        memcpy(buffer, content.data() + position, count);
+        position += count;
+        return count;
+    }
+};
+
+bool report(const std::string &name, bool passed, const std::string &detail)
+{
+    std::cout << name << ": " << (passed ? "OK" : "FAILED " + detail) << std::endl;
+    return passed;
+}
+
+// Every vector kernel must find the same prefix as the scalar loop, for any length and alignment
+bool checkScanKernels()
+{
+    auto kernels = supportedNetasciiKernels();
+    ScanKernel scalar = kernels.back().scan;
+    std::mt19937 random(1);
+    std::vector<char> buffer(SCAN_MAX_LENGTH + SCAN_MAX_ALIGNMENT);
+    for (int round = 0; round < SCAN_ROUNDS; round++)
+    {
+        // From a CR, LF or NUL in almost every byte to none at all
+        int density = random() % 5;
+        for (auto &byte : buffer)
+        {
+            byte = static_cast<char>(random());
+            if ((byte == '\r' || byte == '\n' || byte == '\0') && density == 0)
+            {
+                byte = 'a';
+            }
+            else if (density != 0 && random() % (1 << (3 * density)) == 0)
+            {
+                byte = "\r\n\0"[random() % 3];
+            }
+        }
+        size_t length = random() % (SCAN_MAX_LENGTH + 1);
+        const char *data = buffer.data() + random() % SCAN_MAX_ALIGNMENT;
+        size_t expected = scalar(data, length);
+        for (auto &kernel : kernels)
+        {
+            size_t found = kernel.scan(data, length);
+            if (found != expected)
+            {
+                return report("netascii scan kernels", false, std::string(kernel.name) + " found " + std::to_string(found) + " instead of " + std::to_string(expected) + " in " + std::to_string(length) + " bytes");
+            }
+        }
+    }
+    std::string names;
+    for (auto &kernel : kernels)
+    {
+        names += std::string(names.empty() ? "" : ", ") + kernel.name;
+    }
+    return report("netascii scan kernels (" + names + ")", true);
+}
+
+// Data with CR, LF and NUL in 1 of 2 to 1 of 200 bytes
+std::string randomNetascii(std::mt19937 &random, size_t length, int density)
+{
+    static const int oneIn[] = {200, 8, 2};
+    std::string data(length, '\0');
+    for (auto &byte : data)
+    {
+        byte = random() % oneIn[density] == 0 ? "\r\n\0"[random() % 3] : static_cast<char>(random());
+    }
+    return data;
+}
+
+std::string referenceEncode(const std::string &data)
+{
+    std::string encoded;
+    for (char byte : data)
+    {
+        if (byte == '\n')
+        {
+            encoded += "\r\n";
+        }
+        else if (byte == '\r')
+        {
+            encoded += std::string("\r\0", 2);
+        }
+        else
+        {
+            encoded += byte;
+        }
+    }
+    return encoded;
+}
+
+// Encodes into blocks like WriteSession does, reading the data in chunks of random length
+std::string streamEncode(std::mt19937 &random, const std::string &data, size_t blockSize)
+{
+    NetasciiEncoder encoder;
+    std::string encoded;
+    std::vector<char> block(blockSize);
+    size_t chunkStart = 0;
+    size_t chunkEnd = 0;
+    while (true)
+    {
+        size_t filled = 0;
+        while (filled < blockSize)
+        {
+            if (chunkStart == chunkEnd && chunkEnd < data.size())
+            {
+                chunkEnd = std::min(data.size(), chunkEnd + random() % (blockSize + 2));
+            }
+            size_t consumed;
+            filled += encoder.encode(data.data() + chunkStart, chunkEnd - chunkStart, block.data() + filled, blockSize - filled, consumed);
+            chunkStart += consumed;
+            if (chunkStart == data.size() && !encoder.pending())
+            {
+                break;
+            }
+        }
+        encoded.append(block.data(), filled);
+        if (filled < blockSize)
+        {
+            return encoded;
+        }
+    }
+}
+
+// Decodes blocks of random length in place behind a packet header, as ReadSession does
+std::string streamDecode(std::mt19937 &random, const std::string &encoded, size_t maxBlockSize)
+{
+    NetasciiDecoder decoder;
+    std::string decoded;
+    size_t position = 0;
+    while (true)
+    {
+        size_t length = std::min<size_t>(1 + random() % maxBlockSize, encoded.size() - position);
+        bool last = position + length == encoded.size();
+        std::vector<char> packet(4 + length);
+        memcpy(packet.data() + 4, encoded.data() + position, length);
+        position += length;
+        auto block = decoder.decode(packet.data() + 4, length, last);
+        decoded.append(block.data(), block.size());
+        if (last)
+        {
+            return decoded;
+        }
+    }
+}
+
+// Streaming codecs must give the same result however the data are cut into chunks and blocks
+bool checkNetasciiCodec()
+{
+    std::mt19937 random(2);
+    for (int round = 0; round < CODEC_ROUNDS; round++)
+    {
+        std::string data = randomNetascii(random, random() % (CODEC_MAX_LENGTH + 1), random() % 3);
+        std::string encoded = streamEncode(random, data, 1 + random() % CODEC_MAX_BLOCK);
+        if (encoded != referenceEncode(data))
+        {
+            return report("netascii codec", false, "encoding of " + std::to_string(data.size()) + " bytes differs");
+        }
+        if (streamDecode(random, encoded, CODEC_MAX_BLOCK) != data)
+        {
+            return report("netascii codec", false, "decoding of " + std::to_string(encoded.size()) + " bytes differs");
+        }
+        // Malformed netascii, like a lone CR at the end of a block, is decoded the same in blocks and at once
+        std::string malformed = randomNetascii(random, random() % (CODEC_MAX_LENGTH + 1), 2);
+        std::vector<char> packet(4 + malformed.size());
+        memcpy(packet.data() + 4, malformed.data(), malformed.size());
+        auto decodedAtOnce = NetasciiDecoder().decode(packet.data() + 4, malformed.size(), true);
+        std::string whole(decodedAtOnce.data(), decodedAtOnce.size());
+        if (streamDecode(random, malformed, 1 + random() % 50) != whole)
+        {
+            return report("netascii codec", false, "decoding of " + std::to_string(malformed.size()) + " malformed bytes in blocks differs");
+        }
+    }
+    return report("netascii codec", true);
+}
+
+// Logical block numbers survive the trip through 16-bit wire numbers with either rollover,
+// when the receiver's reference is up to a few thousand blocks away
+bool checkBlockNumbers()
+{
+    for (int rollover : {0, 1})
+    {
+        TFTP tftp;
+        tftp.setRollover(rollover);
+        for (uint64_t block = 1; block < 3 * 65536; block++)
+        {
+            int wire = tftp.wireBlockNumber(block);
+            for (int64_t distance : {-3000, -1, 0, 1, 3000})
+            {
+                uint64_t near = static_cast<int64_t>(block) + distance < 0 ? 0 : block + distance;
+                if (tftp.blockNumber(wire, near) != block)
+                {
+                    return report("block numbers", false, "block " + std::to_string(block) + " with rollover " + std::to_string(rollover) + " read back near " + std::to_string(near) + " as " + std::to_string(tftp.blockNumber(wire, near)));
+                }
+            }
+        }
+    }
+    return report("block numbers", true);
+}
+
+// Files of more than 65535 blocks in both directions and both rollovers, lock-step and windowed
+bool checkRolloverTransfers()
+{
+    LoopbackServer server;
+    std::string content(static_cast<size_t>(ROLLOVER_BLOCKS) * ROLLOVER_BLOCK_SIZE + 3, '\0');
+    std::mt19937 random(3);
+    for (auto &byte : content)
+    {
+        byte = static_cast<char>(random());
+    }
+    server.put("rollover", content);
+    setLogLevel(LogLevel::Off);
+    std::string failure;
+    for (int rollover : {0, 1})
+    {
+        for (bool read : {true, false})
+        {
+            for (int windowsize : {1, 16})
+            {
+                TransferOptions options;
+                options.port = server.port();
+                options.filePath = read ? "rollover" : "uploaded";
+                options.read = read;
+                options.blockSizeOffer = ROLLOVER_BLOCK_SIZE;
+                options.windowSizeOffer = windowsize;
+                options.rollover = rollover;
+                MemorySink sink;
+                MemorySource source(content);
+                TransferSession session(options);
+                if (read)
+                {
+                    session.setSink(sink);
+                }
+                else
+                {
+                    session.setSource(source);
+                }
+                auto result = session.run();
+                if (failure.empty() && (!result.succeeded || (read ? sink.data : server.get("uploaded")) != content))
+                {
+                    failure = std::string(read ? "read" : "write") + " with rollover " + std::to_string(rollover) + " and window " + std::to_string(windowsize) + " " + (result.succeeded ? "corrupted the file" : result.error);
+                }
+            }
+        }
+    }
+    setLogLevel(LogLevel::Info);
+    return report("block number rollover transfers", failure.empty(), failure);
+}
+
+// The sliding bitmap classifies arrivals like a set of all received blocks, across word and ring boundaries
+bool checkSequenceTracker()
+{
+    std::mt19937_64 random(4);
+    for (int round = 0; round < SEQUENCE_ROUNDS; round++)
+    {
+        uint64_t window = 1 + random() % 300;
+        uint64_t first = random() % 3 == 0 ? random() % 100000 : 1;
+        SequenceTracker tracker(window, first);
+        std::set<uint64_t> received;
+        uint64_t missing = first;
+        for (int arrival = 0; arrival < SEQUENCE_ARRIVALS; arrival++)
+        {
+            // Mostly within the window, some beyond it and some already passed
+            uint64_t block = missing + random() % (window + 20);
+            block -= std::min<uint64_t>(block - 1, random() % 4 == 0 ? random() % 10 : 0);
+            auto expected = SequenceTracker::Arrival::New;
+            if (block < missing || received.count(block) != 0)
+            {
+                expected = SequenceTracker::Arrival::Duplicate;
+            }
+            else if (block - missing >= window)
+            {
+                expected = SequenceTracker::Arrival::Ahead;
+            }
+            if (tracker.receive(block) != expected)
+            {
+                return report("sequence tracker", false, "block " + std::to_string(block) + " misclassified with window " + std::to_string(window));
+            }
+            if (expected == SequenceTracker::Arrival::New)
+            {
+                received.insert(block);
+                while (received.count(missing) != 0)
+                {
+                    missing++;
+                }
+            }
+            if (tracker.firstMissing() != missing)
+            {
+                return report("sequence tracker", false, "first missing block is " + std::to_string(tracker.firstMissing()) + " instead of " + std::to_string(missing));
+            }
+        }
+    }
+    return report("sequence tracker", true);
+}
+
+int main()
+{
+    bool passed = true;
+    passed &= checkScanKernels();
+    passed &= checkNetasciiCodec();
+    passed &= checkBlockNumbers();
+    passed &= checkRolloverTransfers();
+    passed &= checkSequenceTracker();
+    return passed ? 0 : 1;
+}
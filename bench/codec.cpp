@@ -0,0 +1,192 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include "netascii.hpp"
+#include "log.hpp"
+#include "session.hpp"
+#include "tftp.hpp"
+
+// Microbenchmarks of the per-block packet code: netascii conversion, packet builders and OACK parsing.
+// Every operation is repeated until it ran long enough, then time, throughput and heap allocations per
+// operation are reported
+
+using namespace std::chrono_literals;
+
+#define MINIMAL_BENCH_TIME 200ms
+#define BENCH_BLOCK_SIZE 1428
+
+// Every heap allocation of the process passes through here
+static size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    void *memory = malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    free(memory);
+}
+
+/// Exposes OACK parsing of a session without running a transfer
+class OACKParser : public Session
+{
+public:
+    OACKParser(TransferOptions options) : Session(options) {}
+    void start(EventLoop &) override {}
+    void readable(UDP &) override {}
+    void expired() override {}
+    bool parse(const char *buffer, int length) { return applyOACK(PacketView(buffer, length)); }
+};
+
+struct Measurement
+{
+    double nanoseconds = 0;     // Per operation
+    double allocations = 0;     // Per operation
+    size_t bytesPerOperation = 0;
+};
+
+template <typename Operation>
+Measurement measure(size_t bytesPerOperation, Operation operation);
+void printMeasurement(const std::string &name, const Measurement &measurement);
+std::string makeText(size_t size);
+
+template <typename Operation>
+Measurement measure(size_t bytesPerOperation, Operation operation)
+{
+    size_t operations = 0;
+    size_t allocationsBefore = allocations;
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::duration::zero();
+    while (elapsed < MINIMAL_BENCH_TIME)
+    {
+        // Check the clock only once per round, so it does not dominate short operations
+        for (int i = 0; i < 256; i++)
+        {
+            operation();
+        }
+        operations += 256;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    Measurement measurement;
+    measurement.nanoseconds = std::chrono::duration<double, std::nano>(elapsed).count() / operations;
+    measurement.allocations = static_cast<double>(allocations - allocationsBefore) / operations;
+    measurement.bytesPerOperation = bytesPerOperation;
+    return measurement;
+}
+
+void printMeasurement(const std::string &name, const Measurement &measurement)
+{
+    std::cout << std::setfill(' ') << std::left << std::setw(26) << name << std::right << std::fixed
+              << std::setw(12) << std::setprecision(1) << measurement.nanoseconds
+              << std::setw(12) << std::setprecision(1) << measurement.bytesPerOperation / measurement.nanoseconds * 1e3
+              << std::setw(12) << std::setprecision(2) << measurement.allocations
+              << std::defaultfloat << std::endl;
+}
+
+// Lines of letters, so netascii conversion has line ends to work on
+std::string makeText(size_t size)
+{
+    std::string text(size, 'a');
+    for (size_t i = 0; i < size; i++)
+    {
+        text[i] = i % 64 == 63 ? '\n' : static_cast<char>('a' + i % 26);
+    }
+    return text;
+}
+
+int main()
+{
+    TFTP tftp;
+    volatile size_t kept = 0; // Results are used, so no operation can be left out
+
+    std::cout << "netascii kernel: " << netasciiKernel() << std::endl;
+    std::cout << std::left << std::setw(26) << "operation" << std::right << std::setw(12) << "ns/op"
+              << std::setw(12) << "MB/s" << std::setw(12) << "allocs/op" << std::endl;
+
+    std::string text = makeText(BENCH_BLOCK_SIZE);
+    std::string netascii;
+    for (char c : text)
+    {
+        if (c == '\n')
+        {
+            netascii.push_back('\r');
+        }
+        netascii.push_back(c);
+    }
+    netascii.resize(BENCH_BLOCK_SIZE);
+    // One byte before the block, for a CR held back from the previous block
+    std::vector<char> input(BENCH_BLOCK_SIZE + 1);
+    std::vector<char> output(BENCH_BLOCK_SIZE);
+
+    // Decoding works in place, so every operation starts from a fresh copy of the block
+    NetasciiDecoder decoder;
+    printMeasurement("NetasciiDecoder::decode", measure(BENCH_BLOCK_SIZE, [&]() {
+        memcpy(input.data() + 1, netascii.data(), BENCH_BLOCK_SIZE);
+        kept = kept + decoder.decode(input.data() + 1, BENCH_BLOCK_SIZE).size();
+    }));
+    NetasciiEncoder encoder;
+    printMeasurement("NetasciiEncoder::encode", measure(BENCH_BLOCK_SIZE, [&]() {
+        size_t consumed;
+        kept = kept + encoder.encode(text.data(), BENCH_BLOCK_SIZE, output.data(), BENCH_BLOCK_SIZE, consumed);
+    }));
+
+    std::string fileName = "images/firmware-v2.bin";
+    char packet[MAX_BUFFER];
+    size_t requestLength = tftp.writeRRQ(packet, fileName, "octet", BENCH_BLOCK_SIZE, 5, 16).size();
+    printMeasurement("writeRRQ", measure(requestLength, [&]() {
+        kept = kept + tftp.writeRRQ(packet, fileName, "octet", BENCH_BLOCK_SIZE, 5, 16).size();
+    }));
+    requestLength = tftp.writeWRQ(packet, fileName, "octet", BENCH_BLOCK_SIZE, 1048576, 5, 16).size();
+    printMeasurement("writeWRQ", measure(requestLength, [&]() {
+        kept = kept + tftp.writeWRQ(packet, fileName, "octet", BENCH_BLOCK_SIZE, 1048576, 5, 16).size();
+    }));
+    int block = 0;
+    printMeasurement("writeACK", measure(4, [&]() {
+        block = (block + 1) & 0xffff;
+        kept = kept + TFTP::writeACK(packet, block).size();
+    }));
+    printMeasurement("blockNumberToStr", measure(2, [&]() {
+        block = (block + 1) & 0xffff;
+        kept = kept + tftp.blockNumberToStr(block).size();
+    }));
+
+    std::vector<char> data(BENCH_BLOCK_SIZE + 4);
+    TFTP::writeDATAHeader(data, 1);
+    printMeasurement("PacketView DATA", measure(4, [&]() {
+        PacketView packet(data.data(), data.size());
+        kept = kept + packet.is(Opcode::DATA) + packet.blockNumber() + packet.payload().size();
+    }));
+
+    TransferOptions options;
+    options.filePath = fileName;
+    options.blockSizeOffer = BENCH_BLOCK_SIZE;
+    options.timeoutOffer = 5;
+    options.windowSizeOffer = 16;
+    OACKParser parser(options);
+    std::string oack("\0\6blksize\0" "1428\0timeout\0" "5\0windowsize\0" "16\0tsize\0" "1048576\0", 53);
+    // Messages of the parser about accepted options would flood the terminal, only parsing is measured
+    setLogLevel(LogLevel::Off);
+    auto oackMeasurement = measure(oack.size(), [&]() {
+        kept = kept + parser.parse(oack.data(), oack.size());
+    });
+    setLogLevel(LogLevel::Info);
+    printMeasurement("applyOACK", oackMeasurement);
+    return 0;
+}
@@ -0,0 +1,293 @@
+#include "server.hpp"
+#include <vector>
+
+using namespace std::chrono_literals;
+
+#define SERVER_ADDRESS "127.0.0.1"
+#define SERVER_RETRANSMIT 100ms
+#define SERVER_GIVE_UP_AFTER 50 // Retransmissions without an answer
+#define SERVER_BATCH_SIZE 64
+#define MAX_BLOCK_SIZE (MAX_BUFFER - 4) // Received datagrams must fit into the batch buffers
+
+void writeOACKOption(std::string &oack, const std::string &name, const std::string &value);
+
+void writeOACKOption(std::string &oack, const std::string &name, const std::string &value)
+{
+    oack.append(name).push_back('\0');
+    oack.append(value).push_back('\0');
+}
+
+LoopbackServer::LoopbackServer()
+{
+    listener.createServerSocket(SERVER_ADDRESS, 0);
+    thread = std::thread(&LoopbackServer::run, this);
+}
+
+LoopbackServer::~LoopbackServer()
+{
+    stopping = true;
+    thread.join();
+}
+
+int LoopbackServer::port()
+{
+    return listener.localPort();
+}
+
+void LoopbackServer::put(const std::string &name, std::string content)
+{
+    std::lock_guard<std::mutex> lock(filesLock);
+    files[name] = std::move(content);
+}
+
+std::string LoopbackServer::get(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(filesLock);
+    auto file = files.find(name);
+    return file == files.end() ? std::string() : file->second;
+}
+
+void LoopbackServer::run()
+{
+    char request[MAX_BUFFER];
+    while (!stopping)
+    {
+        try
+        {
+            int length = listener.receiveWithTimeout(request, sizeof request, SERVER_RETRANSMIT);
+            serve(PacketView(request, length));
+        }
+        catch (const TimeoutException &e)
+        {
+            // Check whether to stop
+        }
+        catch (const std::exception &e)
+        {
+            // A failed transfer does not stop the server, the client reports it
+        }
+    }
+}
+
+void LoopbackServer::serve(const PacketView &request)
+{
+    if (!request.is(Opcode::RRQ) && !request.is(Opcode::WRQ))
+    {
+        return;
+    }
+    bool read = request.is(Opcode::RRQ);
+    std::string fileName(request.fileName());
+
+    // Every transfer has its own port, like with a real server
+    UDP transfer;
+    transfer.createServerSocket(SERVER_ADDRESS, 0);
+    transfer.replyTo(listener);
+
+    std::string content;
+    if (read)
+    {
+        std::lock_guard<std::mutex> lock(filesLock);
+        auto file = files.find(fileName);
+        if (file == files.end())
+        {
+            tftp.sendERROR(transfer, 1, "File not found");
+            return;
+        }
+        content = file->second;
+    }
+    auto served = negotiate(request.options(), read, content.size());
+    tftp.setRollover(served.rollover);
+    if (read)
+    {
+        serveRead(transfer, content, served);
+    }
+    else
+    {
+        serveWrite(transfer, fileName, served);
+    }
+}
+
+ServedOptions LoopbackServer::negotiate(const OptionRange &options, bool read, size_t fileSize)
+{
+    ServedOptions served;
+    served.oack = std::string("\0\6", 2);
+    for (auto &option : options)
+    {
+        std::string name(option.name);
+        const char *value = option.value.data(); // Zero-terminated in the request
+        for (auto &c : name)
+        {
+            c = tolower(c);
+        }
+        if (name == "blksize")
+        {
+            served.blocksize = std::clamp(atoi(value), 8, MAX_BLOCK_SIZE);
+            writeOACKOption(served.oack, name, std::to_string(served.blocksize));
+        }
+        else if (name == "windowsize")
+        {
+            served.windowsize = std::clamp(atoi(value), 1, 65535);
+            writeOACKOption(served.oack, name, std::to_string(served.windowsize));
+        }
+        else if (name == "rollover")
+        {
+            served.rollover = atoi(value) == 1 ? 1 : 0;
+            writeOACKOption(served.oack, name, std::to_string(served.rollover));
+        }
+        else if (name == "tsize")
+        {
+            writeOACKOption(served.oack, name, read ? std::to_string(fileSize) : std::string(value));
+        }
+        else if (name == "timeout")
+        {
+            writeOACKOption(served.oack, name, value);
+        }
+    }
+    served.acknowledged = served.oack.size() > 2;
+    return served;
+}
+
+void LoopbackServer::serveRead(UDP &transfer, const std::string &content, const ServedOptions &options)
+{
+    const char *data = content.data();
+    size_t lastBlock = content.size() / options.blocksize + 1;
+    DatagramBatch replies(SERVER_BATCH_SIZE, MAX_BUFFER);
+    OutgoingBatch blocks(options.windowsize);
+    size_t base = 1; // Oldest block not acknowledged
+    size_t next = 1; // Next block to send
+    int unanswered = 0;
+    bool accepted = !options.acknowledged; // The client acknowledged the OACK
+    while (base <= lastBlock)
+    {
+        if (!accepted)
+        {
+            transfer.send(options.oack);
+        }
+        else
+        {
+            while (next < base + options.windowsize && next <= lastBlock)
+            {
+                size_t offset = (next - 1) * options.blocksize;
+                int length = std::min<size_t>(options.blocksize, content.size() - offset);
+                tftp.queue(blocks, next, data + offset, length);
+                next++;
+            }
+            transfer.sendBatch(blocks);
+        }
+
+        try
+        {
+            transfer.receiveBatch(replies, SERVER_RETRANSMIT);
+        }
+        catch (const TimeoutException &e)
+        {
+            if (++unanswered == SERVER_GIVE_UP_AFTER)
+            {
+                return;
+            }
+            next = base; // Send the whole window again
+            continue;
+        }
+        unanswered = 0;
+        for (int i = 0; i < replies.count; i++)
+        {
+            PacketView reply(replies.datagram(i), replies.length(i));
+            if (!reply.is(Opcode::ACK))
+            {
+                continue;
+            }
+            int block = reply.blockNumber();
+            if (!accepted)
+            {
+                accepted = block == 0;
+                continue;
+            }
+            size_t acked = tftp.blockNumber(block, base - 1);
+            if (acked >= base && acked < next)
+            {
+                base = acked + 1;
+                next = base; // Anything after the acknowledged block was lost (RFC 7440)
+            }
+        }
+    }
+}
+
+void LoopbackServer::serveWrite(UDP &transfer, const std::string &name, const ServedOptions &options)
+{
+    std::string content;
+    DatagramBatch blocks(SERVER_BATCH_SIZE, MAX_BUFFER);
+    OutgoingBatch acks(1);
+    size_t expected = 1;
+    int inWindow = 0;
+    int unanswered = 0;
+    bool last = false;
+    if (options.acknowledged)
+    {
+        transfer.send(options.oack);
+    }
+    else
+    {
+        tftp.queueACK(acks, 0);
+        transfer.sendBatch(acks);
+    }
+    while (!last)
+    {
+        try
+        {
+            transfer.receiveBatch(blocks, SERVER_RETRANSMIT);
+        }
+        catch (const TimeoutException &e)
+        {
+            if (++unanswered == SERVER_GIVE_UP_AFTER)
+            {
+                return;
+            }
+            if (expected == 1 && options.acknowledged)
+            {
+                transfer.send(options.oack);
+                continue;
+            }
+            tftp.queueACK(acks, expected - 1);
+            transfer.sendBatch(acks);
+            inWindow = 0;
+            continue;
+        }
+        unanswered = 0;
+        bool outOfOrder = false;
+        for (int i = 0; i < blocks.count && !last; i++)
+        {
+            PacketView block(blocks.datagram(i), blocks.length(i), blocks.payload(i));
+            if (!block.is(Opcode::DATA))
+            {
+                continue;
+            }
+            if (tftp.blockNumber(block.blockNumber(), expected) != expected)
+            {
+                outOfOrder = true;
+                continue;
+            }
+            content.append(block.payload().data(), block.payload().size());
+            last = static_cast<int>(block.payload().size()) < options.blocksize;
+            expected++;
+            if (last)
+            {
+                // Stored before the final ACK, so the file is there once the client finished
+                std::lock_guard<std::mutex> lock(filesLock);
+                files[name] = std::move(content);
+            }
+            if (++inWindow == options.windowsize || last)
+            {
+                tftp.queueACK(acks, expected - 1);
+                transfer.sendBatch(acks);
+                inWindow = 0;
+                outOfOrder = false;
+            }
+        }
+        if (outOfOrder)
+        {
+            // Tell the client where to continue
+            tftp.queueACK(acks, expected - 1);
+            transfer.sendBatch(acks);
+            inWindow = 0;
+        }
+    }
+}
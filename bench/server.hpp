@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "udp.hpp"
+#include "tftp.hpp"
+#include "packet.hpp"
+
+/// Options of a request which the server accepts
+struct ServedOptions
+{
+    int blocksize = DEFAULT_BLOCK_SIZE;
+    int windowsize = 1;
+    int rollover = 0;
+    bool acknowledged = false; // The client offered options, so they are answered with an OACK
+    std::string oack;          // The OACK packet
+};
+
+/// Small TFTP server on loopback which serves files from memory, one transfer at a time.
+/// Stands in for a real server in benchmarks. Supports blksize, tsize, timeout, windowsize and rollover
+class LoopbackServer
+{
+    UDP listener;
+    TFTP tftp;
+    std::map<std::string, std::string> files;
+    std::mutex filesLock;
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+    LoopbackServer(const LoopbackServer &) = delete;
+
+    void run();
+    void serve(const PacketView &request);
+    ServedOptions negotiate(const OptionRange &options, bool read, size_t fileSize);
+    void serveRead(UDP &transfer, const std::string &content, const ServedOptions &options);
+    void serveWrite(UDP &transfer, const std::string &name, const ServedOptions &options);
+
+public:
+    /// Starts serving on a free port of 127.0.0.1
+    LoopbackServer();
+    ~LoopbackServer();
+    int port();
+    /// File which clients can read
+    void put(const std::string &name, std::string content);
+    /// File written by a client. Empty when there is none
+    std::string get(const std::string &name);
+};
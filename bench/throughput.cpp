@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include "log.hpp"
+#include "server.hpp"
+#include "tftpclient.hpp"
+
+// Runs read and write transfers against LoopbackServer over a matrix of block size, window size,
+// file size and mode. Block latency is the time between two consecutive blocks handed to the sink
+// (reads) or taken from the source (writes), so it includes waiting for acknowledgements
+
+using namespace std::chrono_literals;
+
+#define MINIMAL_CASE_TIME 300ms // Small files are transferred repeatedly at least this long
+#define MAXIMAL_RUNS 1000
+
+struct BenchCase
+{
+    bool read;
+    std::string mode;
+    int blocksize;
+    int windowsize;
+    size_t fileSize;
+};
+
+struct BenchResult
+{
+    int runs = 0;
+    int failed = 0;
+    size_t bytes = 0;
+    size_t datagrams = 0;
+    size_t retransmissions = 0;
+    double seconds = 0;
+    double cpuSeconds = 0;
+    std::vector<double> latencies; // Microseconds
+};
+
+/// Keeps downloaded data in memory and records when each block came
+class TimedSink : public Sink
+{
+public:
+    std::vector<char> data;
+    std::vector<std::chrono::steady_clock::time_point> arrivals;
+    void write(size_t offset, const char *buffer, size_t length) override
+    {
+        arrivals.push_back(std::chrono::steady_clock::now());
+        if (data.size() < offset + length)
+        {
+            data.resize(offset + length);
+        }
+        memcpy(data.data() + offset, buffer, length);
+    }
+};
+
+/// Uploads data from memory and records when each block was taken
+class TimedSource : public Source
+{
+    const std::string &content;
+    size_t position = 0;
+
+public:
+    std::vector<std::chrono::steady_clock::time_point> arrivals;
+    TimedSource(const std::string &content) : content(content) {}
+    size_t size() override { return content.size(); }
+    int read(char *buffer, int length) override
+    {
+        arrivals.push_back(std::chrono::steady_clock::now());
+        int taken = std::min<size_t>(length, content.size() - position);
+        memcpy(buffer, content.data() + position, taken);
+        position += taken;
+        return taken;
+    }
+};
+
+std::string makeContent(size_t size, bool text);
+double threadCpuSeconds();
+void addLatencies(std::vector<double> &latencies, const std::vector<std::chrono::steady_clock::time_point> &arrivals);
+double percentile(std::vector<double> &values, double fraction);
+BenchResult runCase(LoopbackServer &server, const BenchCase &benchCase);
+void printHeader();
+void printResult(const BenchCase &benchCase, BenchResult &result);
+
+// Text mode content has lines, so netascii conversion has work to do
+std::string makeContent(size_t size, bool text)
+{
+    std::string content(size, '\0');
+    uint32_t state = 2463534242u;
+    for (size_t i = 0; i < size; i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        content[i] = text ? (i % 64 == 63 ? '\n' : static_cast<char>('a' + state % 26)) : static_cast<char>(state);
+    }
+    return content;
+}
+
+double threadCpuSeconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+void addLatencies(std::vector<double> &latencies, const std::vector<std::chrono::steady_clock::time_point> &arrivals)
+{
+    for (size_t i = 1; i < arrivals.size(); i++)
+    {
+        latencies.push_back(std::chrono::duration<double, std::micro>(arrivals[i] - arrivals[i - 1]).count());
+    }
+}
+
+double percentile(std::vector<double> &values, double fraction)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+BenchResult runCase(LoopbackServer &server, const BenchCase &benchCase)
+{
+    bool text = benchCase.mode == "netascii";
+    std::string content = makeContent(benchCase.fileSize, text);
+    std::string name = "bench.bin";
+    if (benchCase.read)
+    {
+        // The server sends stored data as they are, so store them already converted
+        std::string stored;
+        for (char c : content)
+        {
+            if (c == '\n')
+            {
+                stored.push_back('\r');
+            }
+            stored.push_back(c);
+        }
+        server.put(name, stored);
+    }
+
+    TransferOptions options;
+    options.port = server.port();
+    options.filePath = name;
+    options.read = benchCase.read;
+    options.mode = benchCase.mode;
+    options.blockSizeOffer = benchCase.blocksize;
+    options.windowSizeOffer = benchCase.windowsize;
+
+    BenchResult result;
+    auto caseStart = std::chrono::steady_clock::now();
+    while (result.runs < MAXIMAL_RUNS && (result.runs == 0 || std::chrono::steady_clock::now() - caseStart < MINIMAL_CASE_TIME))
+    {
+        TimedSink sink;
+        TimedSource source(content);
+        TransferSession transfer(options);
+        if (benchCase.read)
+        {
+            transfer.setSink(sink);
+        }
+        else
+        {
+            transfer.setSource(source);
+        }
+
+        double cpuStart = threadCpuSeconds();
+        auto start = std::chrono::steady_clock::now();
+        auto transferResult = transfer.run();
+        result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.cpuSeconds += threadCpuSeconds() - cpuStart;
+
+        result.runs++;
+        result.failed += !transferResult.succeeded;
+        result.bytes += transferResult.bytes;
+        result.datagrams += transferResult.stats.datagramsSent + transferResult.stats.datagramsReceived;
+        result.retransmissions += transferResult.stats.retransmissions;
+        addLatencies(result.latencies, benchCase.read ? sink.arrivals : source.arrivals);
+    }
+    return result;
+}
+
+void printHeader()
+{
+    std::cout << std::setfill(' ') << std::left << std::setw(6) << "dir" << std::setw(9) << "mode" << std::right
+              << std::setw(8) << "blksize" << std::setw(7) << "window" << std::setw(10) << "size"
+              << std::setw(6) << "runs" << std::setw(10) << "MB/s" << std::setw(11) << "packets/s"
+              << std::setw(11) << "CPU ms/MB" << std::setw(10) << "p50 us" << std::setw(10) << "p99 us"
+              << std::setw(9) << "retrans" << std::endl;
+}
+
+void printResult(const BenchCase &benchCase, BenchResult &result)
+{
+    double megabytes = result.bytes / 1e6;
+    std::cout << std::setfill(' ') << std::left << std::setw(6) << (benchCase.read ? "read" : "write") << std::setw(9) << benchCase.mode << std::right
+              << std::setw(8) << benchCase.blocksize << std::setw(7) << benchCase.windowsize << std::setw(10) << benchCase.fileSize
+              << std::setw(6) << result.runs << std::fixed << std::setprecision(1)
+              << std::setw(10) << (result.seconds > 0 ? megabytes / result.seconds : 0)
+              << std::setw(11) << std::setprecision(0) << (result.seconds > 0 ? result.datagrams / result.seconds : 0)
+              << std::setw(11) << std::setprecision(2) << (megabytes > 0 ? result.cpuSeconds * 1000 / megabytes : 0)
+              << std::setw(10) << std::setprecision(1) << percentile(result.latencies, 0.5)
+              << std::setw(10) << percentile(result.latencies, 0.99)
+              << std::setw(9) << result.retransmissions;
+    if (result.failed != 0)
+    {
+        std::cout << "  " << result.failed << " FAILED";
+    }
+    std::cout << std::defaultfloat << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    // --quick runs a smaller matrix for a fast check
+    bool quick = argc > 1 && std::string(argv[1]) == "--quick";
+    std::vector<int> blocksizes = {512, 1024, 1428};
+    std::vector<int> windowsizes = {1, 8, 32};
+    std::vector<size_t> fileSizes = {64 * 1024, 4 * 1024 * 1024};
+    std::vector<std::string> modes = {"octet", "netascii"};
+    if (quick)
+    {
+        blocksizes = {1428};
+        windowsizes = {1, 16};
+        fileSizes = {1024 * 1024};
+    }
+
+    // Transfers report every block, only the results are printed
+    setLogLevel(LogLevel::Off);
+    LoopbackServer server;
+    printHeader();
+    int failed = 0;
+    for (bool read : {true, false})
+    {
+        for (auto &mode : modes)
+        {
+            for (int blocksize : blocksizes)
+            {
+                for (int windowsize : windowsizes)
+                {
+                    for (size_t fileSize : fileSizes)
+                    {
+                        BenchCase benchCase{read, mode, blocksize, windowsize, fileSize};
+                        auto result = runCase(server, benchCase);
+                        printResult(benchCase, result);
+                        failed += result.failed;
+                    }
+                }
+            }
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
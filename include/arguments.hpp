@@ -12,4 +12,5 @@ struct CustomArgLine // Constructs argv-like array from a line string
 };
 
 cxxopts::Options setupArguments();
-cxxopts::ParseResult parseArguments(CustomArgLine&);
\ No newline at end of file
+cxxopts::ParseResult parseArguments(CustomArgLine&);
+cxxopts::ParseResult parseArguments(int argc, const char *const *argv);
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+#include <chrono>
+#include <coroutine>
+#include <memory>
+#include "session.hpp"
+#include "task.hpp"
+
+/// Session written as a coroutine. Instead of reacting to events, the transfer awaits them:
+/// receive() and sleep() suspend it until a datagram comes or the time passes, while the
+/// event loop runs other sessions. A suspended transfer keeps only its coroutine frame
+class CoroutineSession : public Session
+{
+    Task<TransferResult> task;
+    std::coroutine_handle<> waiting; // Suspended in receive() or sleep()
+    DatagramBatch *waitingBatch = nullptr;
+    int receivedCount = 0;
+    bool listening = true; // The loop delivers datagrams of the connection
+
+    void listen(bool enabled);
+    void resume();
+    void checkFinished();
+
+protected:
+    /// The transfer itself, started by start()
+    virtual Task<TransferResult> body() = 0;
+
+public:
+    struct ReceiveAwaiter
+    {
+        CoroutineSession &session;
+        DatagramBatch &batch;
+        std::chrono::microseconds timeout;
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> handle);
+        int await_resume() { return session.receivedCount; }
+    };
+    struct SleepAwaiter
+    {
+        CoroutineSession &session;
+        std::chrono::microseconds duration;
+        bool await_ready() { return duration.count() <= 0; }
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() {}
+    };
+    struct SendAwaiter
+    {
+        int sent;
+        // Datagrams never wait for the socket, a full send buffer drops them like the network would
+        bool await_ready() { return true; }
+        void await_suspend(std::coroutine_handle<>) {}
+        int await_resume() { return sent; }
+    };
+
+    CoroutineSession(TransferOptions options) : Session(options) {}
+    /// Datagrams from the server, at most the batch capacity. 0 when none came before the timeout
+    ReceiveAwaiter receive(DatagramBatch &batch, std::chrono::microseconds timeout) { return {*this, batch, timeout}; }
+    /// Continues after the given time
+    SleepAwaiter sleep(std::chrono::microseconds duration) { return {*this, duration}; }
+    /// Sends all queued datagrams. Returns the number of sent ones
+    SendAwaiter send(OutgoingBatch &batch) { return {connection.sendBatch(batch)}; }
+
+    void start(EventLoop &loop) override;
+    void readable(UDP &socket) override;
+    void expired() override;
+    void release() override;
+};
+
+/// Downloads a file (RRQ) in a coroutine: windowed reads, retransmissions and OACK handling
+/// written as one linear function. Multicast and the background writer are left to ReadSession
+class CoroutineReadSession : public CoroutineSession
+{
+    std::unique_ptr<Sink> ownedSink;
+    Sink *sink = nullptr;
+
+protected:
+    Task<TransferResult> body() override { return read(); }
+
+public:
+    CoroutineReadSession(TransferOptions options) : CoroutineSession(options) {}
+    Task<TransferResult> read();
+    void release() override;
+};
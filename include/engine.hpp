@@ -0,0 +1,43 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "eventloop.hpp"
+#include "ring.hpp"
+
+/// Spreads sessions over event loops running in threads pinned to separate cores.
+/// A session lives in one shard from its start to its end, so its sockets, timers and buffers
+/// are touched only by that shard's thread. Shards share nothing but their inboxes and load counters
+class ShardedEngine
+{
+    struct Shard
+    {
+        EventLoop loop;
+        SpscRing<Session *> inbox; // Sessions placed on this shard, not yet started
+        std::atomic<int> load{0};  // Placed and not yet finished sessions
+        std::thread thread;
+        Shard();
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<bool> stopping{false};
+    std::mutex mutex;
+    std::condition_variable sessionFinished;
+    size_t finishedCount = 0;
+    ShardedEngine(const ShardedEngine &) = delete;
+
+    void runShard(Shard &shard, int cpu);
+
+public:
+    /// 0 shards = one per available core
+    ShardedEngine(int shardCount = 0);
+    ~ShardedEngine();
+    int shardCount() const { return shards.size(); }
+    /// Places the session on the least loaded shard, which starts it
+    void submit(Session &session);
+    /// Runs the sessions until all of them finish. At most concurrency of them are in progress at once
+    void run(std::vector<std::unique_ptr<Session>> &sessions, int concurrency);
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "session.hpp"
+
+/// Drives many sessions from one thread. Sockets are watched with epoll and retransmission
+/// timers of all sessions are kept ordered by their deadlines
+class EventLoop
+{
+    int epollFd;
+    int wakeFd; // Eventfd which interrupts poll() from other threads
+    std::unordered_map<int, std::pair<Session *, UDP *>> watched; // By socket descriptor
+    std::unordered_map<int, Session *> signals;                   // By eventfd descriptor
+    std::set<std::pair<std::chrono::steady_clock::time_point, Session *>> timers;
+    int active = 0;
+    EventLoop(const EventLoop &) = delete;
+
+    void deliver(Session &session, UDP *socket, bool signalled = false); // nullptr socket = the timer expired
+    void retire(Session &session);
+
+public:
+    /// Called in the loop thread for each finished session
+    std::function<void(Session &)> onFinished;
+
+    EventLoop();
+    ~EventLoop();
+    /// Datagrams on the socket are delivered to the session
+    void watch(Session &session, UDP &socket);
+    /// The session is called through Session::signalled() when the eventfd is written to from another thread
+    void watchSignal(Session &session, int descriptor);
+    /// Stops or resumes delivering datagrams of a watched socket. Stopped datagrams wait in the socket
+    void listen(UDP &socket, bool enabled);
+    /// The session is called after the given time. Replaces its previous timer
+    void schedule(Session &session, std::chrono::microseconds after);
+    /// Sends the request of the session. The session is driven by this loop until it finishes
+    void start(Session &session);
+    /// Waits for the next datagrams or expired timers and handles them. Returns early after wake()
+    void poll();
+    /// Interrupts poll(). Can be called from any thread
+    void wake();
+    /// Sessions started and not yet finished
+    int activeSessions() const { return active; }
+    /// Runs the sessions until all of them finish. At most concurrency of them are in progress at once,
+    /// the next one starts when another finishes
+    void run(std::vector<std::unique_ptr<Session>> &sessions, int concurrency);
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+// Messages are recorded into a lock-free ring of the calling thread and written to the terminal by
+// a logging thread, so the network loop never waits for the terminal
+
+enum class LogLevel
+{
+    Debug, // Every block, see -v
+    Info,
+    Error, // Written to stderr
+    Off
+};
+
+/// Messages of every block, recorded as numbers only at the Debug level (-v). The logging thread turns them into text
+enum class LogEvent : uint8_t
+{
+    Text,          // Formatted by the caller
+    BlockReceived, // Bytes, block number
+    BlockSent,     // Bytes, block number
+    AckReceived,   // Block number
+    AckSent,       // Block number
+    AckResent,     // Block number
+    WindowResent   // First block number
+};
+
+// Name of the session handled by the current thread, printed with each message when transferring more files.
+// Must stay valid until its messages are written, see internLogName
+extern thread_local const char *sessionName;
+
+extern std::atomic<LogLevel> logLevel;
+
+/// Messages below the level are not recorded. Info by default
+void setLogLevel(LogLevel level);
+inline bool logEnabled(LogLevel level) { return level >= logLevel.load(std::memory_order_relaxed); }
+/// Records a message without waiting. When the ring of the thread is full, the message is dropped and counted
+void logText(LogLevel level, std::string text);
+void logEvent(LogLevel level, LogEvent event, int64_t first, int64_t second = 0);
+/// Waits until every message recorded so far is written. Used before writing to the terminal directly
+void flushLog();
+/// Copy of the name which lives until it is released as many times as it was interned
+const char *internLogName(const std::string &name);
+/// Drops one use of an interned name. It is freed after the messages the thread recorded before are written
+void releaseLogName(const char *name);
+
+/// One message put together with operator<< and recorded when the line is destroyed
+class LogLine
+{
+    LogLevel level;
+    std::ostringstream stream;
+
+public:
+    LogLine(LogLevel level) : level(level) {}
+    ~LogLine();
+    LogLine(const LogLine &) = delete;
+    template <typename T>
+    LogLine &operator<<(const T &value)
+    {
+        if (logEnabled(level))
+        {
+            stream << value;
+        }
+        return *this;
+    }
+};
+
+inline LogLine logDebug() { return LogLine(LogLevel::Debug); }
+inline LogLine logInfo() { return LogLine(LogLevel::Info); }
+void printError(std::string error);
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <vector>
+
+/// Length of the longest prefix without CR, LF and NUL, the only bytes netascii conversion changes.
+/// Scans with the widest vector instructions of the CPU, chosen on the first call
+size_t scanNetascii(const char *data, size_t length);
+/// Kernel used by scanNetascii: "avx512", "avx2", "sse2" or "scalar"
+const char *netasciiKernel();
+
+typedef size_t (*ScanKernel)(const char *data, size_t length);
+
+struct NetasciiKernel
+{
+    ScanKernel scan;
+    const char *name;
+};
+
+/// Kernels the CPU can run, widest first and "scalar" last. All of them give the same results
+std::vector<NetasciiKernel> supportedNetasciiKernels();
+
+/// Decodes the netascii blocks of one transfer: CR LF becomes LF and CR NUL becomes CR.
+/// A CR at the end of a block is held back until the next block shows what follows it
+class NetasciiDecoder
+{
+    bool pendingCR = false;
+
+public:
+    /// Converts a block in place. When a CR held back from the previous block turns out to stand alone,
+    /// it is put before the block, so data[-1] must be writable (the payload follows its packet header).
+    /// After the last block nothing is held back
+    std::span<char> decode(char *data, size_t length, bool last = false);
+};
+
+/// Encodes data of one transfer to netascii: LF becomes CR LF and CR becomes CR NUL.
+/// Output is cut anywhere, also between the two bytes of a pair
+class NetasciiEncoder
+{
+    char carried = 0; // Second byte of a pair which did not fit into the previous output
+    bool carrying = false;
+
+public:
+    /// Encodes input into output until one of them runs out. Returns the length of the output
+    /// and sets consumed to the number of input bytes used
+    size_t encode(const char *input, size_t length, char *output, size_t capacity, size_t &consumed);
+    /// Part of the encoded data is still waiting for the next output
+    bool pending() const { return carrying; }
+};
@@ -0,0 +1,93 @@
+#pragma once
+#include <charconv>
+#include <span>
+#include <string_view>
+
+/// Opcodes of TFTP packets (RFC 1350, OACK from RFC 2347)
+enum class Opcode
+{
+    None = 0, // Not a well-formed packet
+    RRQ = 1,
+    WRQ = 2,
+    DATA = 3,
+    ACK = 4,
+    ERROR = 5,
+    OACK = 6
+};
+
+/// Option of a request or OACK. Both views point into the packet and are followed by its zero byte
+struct PacketOption
+{
+    std::string_view name;
+    std::string_view value;
+};
+
+/// Walks the name and value pairs of options. A pair cut off by the end of the packet ends the walk
+class OptionIterator
+{
+    const char *position;
+    const char *end;
+    PacketOption option;
+
+    /// Reads the pair at position, or moves to end when there is no whole pair
+    void read();
+
+public:
+    OptionIterator(const char *position, const char *end);
+    const PacketOption &operator*() const { return option; }
+    const PacketOption *operator->() const { return &option; }
+    OptionIterator &operator++();
+    bool operator==(const OptionIterator &other) const { return position == other.position; }
+};
+
+struct OptionRange
+{
+    OptionIterator first;
+    OptionIterator last;
+    OptionIterator begin() const { return first; }
+    OptionIterator end() const { return last; }
+};
+
+/// Non-owning view of a received datagram. The constructor checks the packet once, accessors only
+/// read its fields. Accessors of other packet types than the one received must not be used.
+/// When the datagram was received into a targeted batch slot, its header and its body (the DATA payload
+/// or the ERROR message) lie apart. Options can be read only from datagrams received whole
+class PacketView
+{
+    const char *header;
+    const char *body; // Part after the 4 bytes of opcode and block number or error code
+    int length;
+    int optionsOffset = 0; // Where options of a request or OACK start
+    Opcode type = Opcode::None;
+
+public:
+    PacketView(const char *datagram, int length) : PacketView(datagram, length, datagram + 4) {}
+    PacketView(const char *header, int length, const char *body);
+    Opcode opcode() const { return type; }
+    /// Well-formed packet of a known type
+    bool valid() const { return type != Opcode::None; }
+    bool is(Opcode opcode) const { return type == opcode; }
+    /// Length of the whole datagram
+    int size() const { return length; }
+
+    /// DATA and ACK. The number as it is on the wire, see TFTP::blockNumber
+    int blockNumber() const { return (static_cast<unsigned char>(header[2]) << 8) | static_cast<unsigned char>(header[3]); }
+    /// DATA
+    std::span<const char> payload() const { return {body, static_cast<size_t>(length - 4)}; }
+    /// ERROR
+    int errorCode() const { return blockNumber(); }
+    std::string_view errorMessage() const;
+    /// RRQ and WRQ
+    std::string_view fileName() const { return header + 2; }
+    std::string_view mode() const { return header + 3 + fileName().length(); }
+    /// RRQ, WRQ and OACK
+    OptionRange options() const;
+};
+
+/// Whole text as a decimal number
+template <typename T>
+bool parseNumber(std::string_view text, T &number)
+{
+    auto parsed = std::from_chars(text.data(), text.data() + text.length(), number);
+    return parsed.ec == std::errc() && parsed.ptr == text.data() + text.length() && !text.empty();
+}
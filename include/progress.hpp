@@ -0,0 +1,20 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+
+/// Progress of one transfer, reported a few times per second instead of a line per block:
+/// bytes done, current and average throughput and the time left when the size is known
+class ProgressReporter
+{
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point lastReport;
+    size_t lastBytes = 0; // Done at the last report
+
+    void report(std::chrono::steady_clock::time_point now, size_t bytes, size_t total);
+
+public:
+    /// Starts measuring, the first report comes one interval later
+    void start();
+    /// Bytes done so far, called after every block. Total is 0 when the size is unknown
+    void update(size_t bytes, size_t total);
+};
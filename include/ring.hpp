@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/// Lock-free queue for exactly one producer thread and one consumer thread
+template <typename T>
+class SpscRing
+{
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0}; // Next item to pop, moved by the consumer
+    alignas(64) std::atomic<size_t> tail{0}; // Next free slot, moved by the producer
+
+public:
+    /// Capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    /// Returns false when the ring is full
+    bool push(const T &item)
+    {
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail - head.load(std::memory_order_acquire) == slots.size())
+        {
+            return false;
+        }
+        slots[currentTail & mask] = item;
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Returns false when the ring is empty
+    bool pop(T &item)
+    {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = slots[currentHead & mask];
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+};
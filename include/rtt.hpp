@@ -0,0 +1,35 @@
+#pragma once
+#include <chrono>
+
+/// Retransmission timeout computed from measured round-trip times (RFC 6298),
+/// with exponential backoff and Karn's rule for retransmitted packets
+class RttEstimator
+{
+    std::chrono::microseconds smoothed{0};
+    std::chrono::microseconds variance{0};
+    std::chrono::microseconds base;         // Timeout before backoff
+    std::chrono::microseconds waited{0};    // Time spent in timeouts since the peer last answered
+    std::chrono::steady_clock::time_point sentAt;
+    int backoffShift = 0;
+    bool measured = false;
+    bool pending = false;   // A packet is waiting for its answer
+    bool ambiguous = false; // It was retransmitted, the answer cannot be matched to one of the copies
+
+    void sample(std::chrono::microseconds rtt);
+
+public:
+    std::chrono::microseconds minimum;
+    std::chrono::microseconds maximum;
+    std::chrono::microseconds giveUpAfter; // 0 = never give up
+    size_t retransmissions = 0; // Packets sent again
+    size_t timeouts = 0;        // Expired retransmission timeouts
+
+    RttEstimator();
+    /// A packet which the peer answers was sent
+    void sent(bool retransmission = false);
+    /// The peer answered. Measures the round trip if possible and resets the backoff
+    void answered();
+    /// Doubles the timeout after it expired. Returns false when it is time to give up
+    bool backoff();
+    std::chrono::microseconds timeout() const;
+};
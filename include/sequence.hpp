@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/// Blocks received so far, as a sliding bitmap of logical block numbers which starts at the first
+/// missing block. Each arrival is classified in constant time. Moving past blocks received in a row
+/// takes whole words of the bitmap at once
+class SequenceTracker
+{
+    std::vector<uint64_t> words; // Ring of bits, block b is bit b % 64 of word b / 64 % words.size()
+    uint64_t window;             // Blocks tracked from the first missing one on
+    uint64_t missing;            // First block not received
+
+    bool test(uint64_t block) const { return words[block / 64 % words.size()] >> (block % 64) & 1; }
+
+public:
+    enum class Arrival
+    {
+        New,
+        Duplicate, // Received already, or before the first missing block
+        Ahead      // Beyond the window, it cannot be remembered yet
+    };
+
+    /// Tracks window blocks from block first on
+    SequenceTracker(uint64_t window = 1, uint64_t first = 1);
+    Arrival classify(uint64_t block) const;
+    /// Classifies the block and remembers it when it is new
+    Arrival receive(uint64_t block);
+    uint64_t firstMissing() const { return missing; }
+    /// Last block of those received in a row from the first one
+    uint64_t lastInOrder() const { return missing - 1; }
+};
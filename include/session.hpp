@@ -0,0 +1,212 @@
+#pragma once
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "udp.hpp"
+#include "packet.hpp"
+#include "progress.hpp"
+#include "sequence.hpp"
+#include "tftp.hpp"
+#include "sink.hpp"
+#include "writer.hpp"
+
+class EventLoop;
+
+/// What to transfer and which options to offer to the server
+struct TransferOptions
+{
+    std::string server = "127.0.0.1";
+    int port = 69;
+    std::string filePath;
+    std::string mode = "binary";
+    bool read = true;
+    int blockSizeOffer = DEFAULT_BLOCK_SIZE; // Larger offers are limited by the smallest MTU
+    int timeoutOffer = 0; // 0 = offer none and never give up on a silent server
+    int windowSizeOffer = 1;
+    int rollover = 0; // Block number which follows 65535, see TFTP::setRollover
+    bool multicast = false;
+    bool background = false; // Write received data to disk from a separate thread
+    bool coroutine = false;  // Read with CoroutineReadSession instead of ReadSession
+    Sink *sink = nullptr;     // Destination of a read. The local file named like the remote one when null
+    Source *source = nullptr; // Origin of a write. The local file named like the remote one when null
+};
+
+/// Counters of a finished transfer
+struct TransferStats
+{
+    size_t datagramsSent = 0;
+    size_t datagramsReceived = 0;
+    size_t retransmissions = 0;
+    size_t timeouts = 0;
+    int blocksize = 0;  // Negotiated
+    int windowsize = 0; // Negotiated
+    double seconds = 0;
+};
+
+/// Outcome of a finished transfer
+struct TransferResult
+{
+    bool succeeded = false;
+    size_t bytes = 0;
+    TransferError code = TransferError::None;
+    int serverCode = -1; // Code of the server's ERROR packet, -1 when there was none
+    std::string error;   // Empty when the transfer succeeded
+    TransferStats stats;
+};
+
+/// State of one transfer driven by an EventLoop. A session never waits: it reacts to datagrams
+/// and to its expired retransmission timeout, and asks the loop to be called again
+class Session
+{
+    bool done = false;
+    std::chrono::steady_clock::time_point deadline; // Of the pending timer, managed by the loop
+    std::vector<UDP *> sockets;                     // Watched by the loop
+    std::vector<int> signalDescriptors;             // Eventfds watched by the loop
+    friend class EventLoop;
+
+protected:
+    TransferOptions options;
+    EventLoop *loop = nullptr;
+    UDP connection;
+    TFTP tftp;
+    int blockSizeOffer;
+    int blocksize = DEFAULT_BLOCK_SIZE;
+    int windowsize = 1;
+    long unsigned int transferSize = 0;
+    MulticastInfo multicast;
+    TransferStats stats;
+    ProgressReporter progress; // Started by connect(), updated after each batch of blocks
+
+    /// Creates the socket, registers it with the loop and chooses the block size to offer
+    void connect();
+    /// Calls expired() after the current retransmission timeout, unless a datagram comes first
+    void rearm();
+    /// Updates negotiated options from an OACK. Returns false when the packet is not an OACK
+    bool applyOACK(const PacketView &packet);
+    /// Marks the transfer as successfully finished
+    void complete(size_t bytes);
+
+public:
+    std::string name; // Printed with messages of this session
+    const char *logName = ""; // The name as kept by the logger, set when the session starts
+    size_t transferred = 0;
+    std::string error; // Empty when the transfer succeeded
+    TransferError code = TransferError::None;
+    int serverCode = -1;
+    std::chrono::steady_clock::time_point startedAt;
+    std::chrono::steady_clock::time_point finishedAt;
+
+    Session(TransferOptions options);
+    virtual ~Session() {}
+    Session(const Session &) = delete;
+    /// Read or write session according to the options
+    static std::unique_ptr<Session> create(TransferOptions options);
+
+    /// Sends the request
+    virtual void start(EventLoop &loop) = 0;
+    /// Datagrams are waiting in one of the sockets of this session
+    virtual void readable(UDP &socket) = 0;
+    /// Nothing came in time
+    virtual void expired() = 0;
+    /// An eventfd given to EventLoop::watchSignal() was written to
+    virtual void signalled() {}
+    /// Releases sockets and buffers of a finished session and collects its stats
+    virtual void release();
+    /// Stops the transfer after an error
+    void fail(std::string message, TransferError code = TransferError::Protocol, int serverCode = -1);
+    /// Stops the transfer after an exception, classified by its type
+    void fail(const std::exception &exception);
+    /// Outcome of a finished session
+    TransferResult result() const;
+    bool finished() const { return done; }
+    bool succeeded() const { return done && error.empty(); }
+};
+
+/// Downloads a file (RRQ), also from a multicast group
+class ReadSession : public Session
+{
+    std::unique_ptr<Sink> ownedSink;
+    Sink *sink = nullptr;
+    std::unique_ptr<DatagramBatch> batch;
+    std::unique_ptr<OutgoingBatch> acks;
+    // Blocks are written in order, so only the next block is new. Anything later is a gap
+    SequenceTracker sequence;
+    uint64_t lastAckedBlock = 0;  // Server sends windowsize blocks after each ACK (RFC 7440)
+    int outOfOrderCount = 0;    // Duplicate or unexpected blocks since the last progress
+    size_t written = 0;         // Bytes of the file received in order
+    bool receiveToFile = false; // Block size is settled, payloads can be received right into the file mapping
+    // With a background writer, payloads are received into its buffers instead of the mapping
+    std::unique_ptr<BackgroundWriter> writer;
+    std::vector<char *> writerBuffers;
+    bool starved = false; // All writer buffers are queued. The socket is not watched until some come back
+
+    // Multicast (RFC 2090). Blocks may arrive from the middle of the file (when joining a running transfer),
+    // so every received block is remembered and written on its own offset
+    std::unique_ptr<UDP> group;
+    SequenceTracker received;
+    long lastBlock = -1;
+    size_t fileLength = 0;
+
+    /// Returns false when the background writer has no free buffers for the batch
+    bool targetBatch();
+    /// Stops receiving until the background writer returns buffers
+    void waitForWriter();
+    /// Returns true when the last block was received
+    bool receiveDatagram(int index);
+    void joinGroup();
+    void receiveMulticast(UDP &socket);
+    void sendACK(uint64_t blockNumber);
+    void finishReading(size_t length);
+
+public:
+    ReadSession(TransferOptions options) : Session(options) {}
+    void start(EventLoop &loop) override;
+    void readable(UDP &socket) override;
+    void expired() override;
+    void signalled() override;
+    void release() override;
+};
+
+/// Uploads a file (WRQ) with a sliding window of blocks
+class WriteSession : public Session
+{
+    std::unique_ptr<Source> ownedSource;
+    Source *source = nullptr;
+    bool requesting = true; // Waiting for the answer to WRQ
+    // Blocks base..next-1 are in flight. They are kept in the window buffer until acknowledged,
+    // so they can be retransmitted without reading the file again.
+    std::vector<char> window;
+    std::vector<int> lengths;
+    std::unique_ptr<OutgoingBatch> blocks; // The whole window leaves with one system call
+    // Netascii mode: data read from the source and not encoded yet
+    NetasciiEncoder encoder;
+    std::vector<char> unencoded;
+    size_t unencodedStart = 0;
+    size_t unencodedEnd = 0;
+    bool sourceEnded = false;
+    std::unique_ptr<DatagramBatch> replies;
+    long base = 1;
+    long next = 1;
+    long lastBlock = -1; // Known after the short (final) block was read
+    long resentFrom = 0; // Base of the window last resent after a duplicate ACK
+
+    void acceptReply(const PacketView &packet);
+    void acceptACK(const PacketView &packet);
+    /// Next block of the file in the transfer mode. Shorter than the block size only at the end
+    int readBlock(char *block);
+    void fillWindow();
+    void resendWindow();
+
+public:
+    WriteSession(TransferOptions options) : Session(options) {}
+    void start(EventLoop &loop) override;
+    void readable(UDP &socket) override;
+    void expired() override;
+    void release() override;
+};
+
+std::string base_name(std::string const &path);
+/// Throws TransferException for an ERROR packet received from the server
+[[noreturn]] void throwServerError(const PacketView &packet);
@@ -0,0 +1,67 @@
+#pragma once
+#include <fstream>
+#include <string>
+
+/// Destination of downloaded data
+class Sink
+{
+public:
+    virtual ~Sink() {}
+    /// Reserves space for the whole file. Returns false when there is not enough space
+    virtual bool preallocate(size_t length) { return true; }
+    /// Memory where data from offset up to end can be received directly, so write() of data already
+    /// there copies nothing. nullptr when the sink has no such memory. May invalidate earlier results
+    virtual char *map(size_t offset, size_t end) { return nullptr; }
+    virtual void write(size_t offset, const char *data, size_t length) = 0;
+    /// All data were written and the file has the given length
+    virtual void close(size_t length) {}
+};
+
+/// Origin of uploaded data
+class Source
+{
+public:
+    virtual ~Source() {}
+    /// Total length in bytes, announced to the server as tsize
+    virtual size_t size() = 0;
+    /// Fills the buffer. Returns less than length only at the end of data
+    virtual int read(char *buffer, int length) = 0;
+};
+
+/// Downloaded file written through a shared memory mapping.
+/// Space is reserved with fallocate, so running out of disk fails before the data arrive.
+class MappedFileSink : public Sink
+{
+    int fd = -1;
+    char *mapping = nullptr;
+    size_t mappedLength = 0;
+    size_t expectedLength = 0; // 0 = unknown, the mapping grows as needed
+    size_t writtenEnd = 0;     // End of the data written so far. A file not closed is cut to it
+    MappedFileSink(const MappedFileSink &) = delete;
+
+public:
+    MappedFileSink(std::string path);
+    ~MappedFileSink();
+    bool preallocate(size_t length) override;
+    /// Makes sure the file is mapped at least up to end. May move the mapping, so pointers from at() become invalid
+    void reserve(size_t end);
+    /// Memory of the file at offset. Must be reserved before
+    char *at(size_t offset) { return mapping + offset; }
+    char *map(size_t offset, size_t end) override;
+    /// Copies data to offset, unless they were received there already
+    void write(size_t offset, const char *data, size_t length) override;
+    /// Unmaps the file and cuts it to its final length
+    void close(size_t length) override;
+};
+
+/// Uploaded local file
+class FileSource : public Source
+{
+    std::ifstream file;
+    size_t length;
+
+public:
+    FileSource(std::string path);
+    size_t size() override { return length; }
+    int read(char *buffer, int length) override;
+};
@@ -0,0 +1,6 @@
+#pragma once
+
+constexpr unsigned int str2intHash(const char *str, int h = 0)
+{
+    return !str[h] ? 5381 : (str2intHash(str, h + 1) * 33) ^ str[h];
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+/// Lazily started coroutine which produces a T. Awaiting a Task from another coroutine runs it
+/// and continues the awaiting coroutine when it finishes, without a thread or a stack of its own
+template <typename T>
+class Task
+{
+public:
+    struct promise_type
+    {
+        std::optional<T> value;
+        std::exception_ptr error;
+        std::coroutine_handle<> continuation; // Coroutine awaiting this one
+
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> finished) noexcept
+            {
+                auto continuation = finished.promise().continuation;
+                return continuation ? continuation : std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void return_value(T result) { value = std::move(result); }
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    Task() {}
+    Task(Task &&other) : handle(std::exchange(other.handle, nullptr)) {}
+    Task &operator=(Task &&other)
+    {
+        if (this != &other)
+        {
+            reset();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task &) = delete;
+    ~Task() { reset(); }
+
+    /// Runs the coroutine until its first suspension
+    void start() { handle.resume(); }
+    bool done() const { return handle && handle.done(); }
+    /// Value of a finished coroutine. Rethrows its exception
+    T result()
+    {
+        if (handle.promise().error)
+        {
+            std::rethrow_exception(handle.promise().error);
+        }
+        return std::move(*handle.promise().value);
+    }
+    /// Destroys the coroutine, also a suspended one
+    void reset()
+    {
+        if (handle)
+        {
+            handle.destroy();
+            handle = nullptr;
+        }
+    }
+
+    bool await_ready() const { return done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting)
+    {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+    T await_resume() { return result(); }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+};
@@ -1,21 +1,64 @@
 #pragma once
+#define DEFAULT_BLOCK_SIZE 512
+#include <cstdint>
+#include <span>
 #include <string>
+#include <string_view>
 #include "udp.hpp"
+#include "rtt.hpp"
+#include "netascii.hpp"
+
+/// Parameters of a multicast transfer (RFC 2090) announced by the server in OACKs
+struct MulticastInfo
+{
+    bool enabled = false;
+    std::string address;
+    int port = 0;
+    bool master = false; // Only the master client acknowledges blocks
+};
+
 class TFTP
 {
     bool asciiMode = false;
-    int &timeout;
+    RttEstimator rtt;
+    NetasciiDecoder decoder;
+    char packet[MAX_BUFFER]; // Requests and errors are built here before sending
+    int rollover = 0;        // Block number which follows 65535 on the wire
 
 public:
-    /// Constructed with reference to timeout variable - because it can change in parent scope from time to time
-    TFTP(int &timeout) : timeout(timeout){}
-    std::string makeRRQ(std::string filename, std::string mode = "binary", int blockSize = 512, int timeoutOffer = 0);
-    int sendRRQ(UDP& connection, std::string filename, std::string mode = "binary", int blockSize = 512, int timeoutOffer = 0);
-    std::string makeWRQ(std::string filename, std::string mode = "binary", int blockSize = 512, int transferSize = 0, int timeoutOffer = 0);
-    std::string makeACK(std::string block);
-    std::string blockNumberToStr(int blockNumber);
-    int netasciiToOctet(char *buffer, int length, bool &previous_cr);
-    int octetToNetascii(char *buffer, char *outputWithDoubleCapacity, int length);
-    int receive(UDP &connection, char *buffer, int maxLength, int& networkRecvBytes);
-    int send(UDP& connection, int blockNumber, char *data, int length);
+    TFTP() {}
+    /// Timeout accepted by the server in an OACK. Caps the backed off retransmission timeout. 0 = none was negotiated
+    void setTimeout(int seconds);
+    /// Round-trip estimate which drives retransmissions
+    RttEstimator &roundTrip() { return rtt; }
+    /// Current retransmission timeout. Never longer than the timeout negotiated with the server
+    std::chrono::microseconds retransmitTimeout();
+    /// Block number which follows 65535. Most servers roll over to 0, some to 1. Offered in requests when not 0
+    void setRollover(int value) { rollover = value; }
+    /// Sessions count blocks with 64 bits, only the lowest 16 bits of the count travel in packets.
+    /// Wire number of a block of the transfer
+    int wireBlockNumber(uint64_t blockNumber) const;
+    /// Block of the transfer with the given wire number, the one closest to a block seen recently
+    uint64_t blockNumber(int wireBlockNumber, uint64_t near) const;
+    /// Packet builders write into the given buffer and return the part of it with the packet.
+    /// They throw CustomException when the packet does not fit
+    std::span<char> writeRRQ(std::span<char> packet, std::string_view filename, std::string_view mode = "binary", int blockSize = 512, int timeoutOffer = 0, int windowSize = 1, bool multicast = false);
+    std::span<char> writeWRQ(std::span<char> packet, std::string_view filename, std::string_view mode = "binary", int blockSize = 512, size_t transferSize = 0, int timeoutOffer = 0, int windowSize = 1);
+    /// Opcode and block number are written with one 4-byte store
+    static std::span<char> writeACK(std::span<char> packet, int blockNumber);
+    static std::span<char> writeDATAHeader(std::span<char> packet, int blockNumber);
+    static std::span<char> writeERROR(std::span<char> packet, int errorCode, std::string_view message);
+    int sendRRQ(UDP& connection, std::string_view filename, std::string_view mode = "binary", int blockSize = 512, int timeoutOffer = 0, int windowSize = 1, bool multicast = false);
+    int sendWRQ(UDP& connection, std::string_view filename, std::string_view mode = "binary", int blockSize = 512, size_t transferSize = 0, int timeoutOffer = 0, int windowSize = 1);
+    int sendACK(UDP &connection, uint64_t blockNumber);
+    int sendERROR(UDP &connection, int errorCode, std::string_view message);
+    /// Wire number of a block as two big-endian bytes
+    std::string blockNumberToStr(uint64_t blockNumber);
+    /// Netascii transfer mode was requested
+    bool netascii() const { return asciiMode; }
+    /// Converts a DATA payload of the next block in place, see NetasciiDecoder::decode. Blocks must come in order
+    std::span<char> decodePayload(char *payload, int payloadLength, bool last = false);
+    /// Queues a DATA packet. Payload must already be in the transfer mode
+    void queue(OutgoingBatch &batch, uint64_t blockNumber, const char *data, int length);
+    void queueACK(OutgoingBatch &batch, uint64_t blockNumber);
 };
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+#include <memory>
+#include "session.hpp"
+
+/// Transfers one file without the interactive client, for embedding into other programs.
+/// Downloads go to a Sink and uploads come from a Source; both default to the local file
+/// named like the remote one
+class TransferSession
+{
+    TransferOptions options;
+    TransferSession(const TransferSession &) = delete;
+
+public:
+    TransferSession(TransferOptions options);
+    /// Downloaded data go to the sink. It must live until run() returns
+    void setSink(Sink &sink) { options.sink = &sink; }
+    /// Uploaded data come from the source. It must live until run() returns
+    void setSource(Source &source) { options.source = &source; }
+    /// Runs the whole transfer in the calling thread
+    TransferResult run();
+};
@@ -1,8 +1,14 @@
 #pragma once
 #define MAX_BUFFER 2048
+#define MAX_BATCH_HEADER 16
 #include <netdb.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <chrono>
 #include <exception>
 #include <string>
+#include <vector>
+#include <algorithm>
 
 class UDPException : public std::exception
 {
@@ -14,6 +20,12 @@ public:
     const char *what() const throw();
 };
 
+class TimeoutException : public UDPException
+{
+public:
+    TimeoutException() : UDPException(0, "Timeout!") {}
+};
+
 class CustomException : public std::exception
 {
     std::string message;
@@ -22,25 +34,112 @@ class CustomException : public std::exception
     const char *what() const throw() { return message.c_str(); };
 };
 
+/// Why a transfer failed
+enum class TransferError
+{
+    None = 0,
+    Timeout,     // Server stopped answering
+    ServerError, // Server sent an ERROR packet
+    DiskFull,
+    LocalFile,   // Local file cannot be opened, mapped or resized
+    Network,
+    Protocol     // Server answered something unexpected
+};
+
+class TransferException : public CustomException
+{
+public:
+    TransferError code;
+    int serverCode; // Error code of the server's ERROR packet, -1 when there was none
+    TransferException(TransferError code, std::string message, int serverCode = -1) : CustomException(message), code(code), serverCode(serverCode) {}
+};
+
+/// Preallocated buffers for receiving more datagrams with one system call.
+/// Payload of a datagram (everything after the 4 byte header) can be directed to memory of the caller
+class DatagramBatch
+{
+    int datagramSize;
+    std::vector<char> storage;
+    std::vector<struct mmsghdr> headers;
+    std::vector<struct iovec> vectors;
+    std::vector<struct sockaddr_storage> sources;
+    friend class UDP;
+
+public:
+    int count = 0; // Number of datagrams filled by the last UDP::receiveBatch
+    DatagramBatch(int capacity, int datagramSize);
+    /// Whole datagram, or only its header when the payload was targeted elsewhere
+    char *datagram(int index) { return storage.data() + static_cast<size_t>(index) * datagramSize; }
+    int length(int index) const { return headers[index].msg_len; }
+    int capacity() const { return headers.size(); }
+    /// Next datagram in this slot will have its payload received directly to the given memory
+    void target(int index, char *payload, int maxLength);
+    /// Next datagram in this slot will be received whole into the batch storage
+    void untarget(int index);
+    bool targeted(int index) const { return headers[index].msg_hdr.msg_iovlen == 2; }
+    char *payload(int index) { return static_cast<char *>(vectors[index * 2 + targeted(index)].iov_base) + (targeted(index) ? 0 : 4); }
+    int payloadLength(int index) const { return std::max(length(index) - 4, 0); }
+};
+
+/// Datagrams queued for sending with one system call. Headers are copied, payloads are only referenced
+/// and must stay valid until UDP::sendBatch
+class OutgoingBatch
+{
+    std::vector<char> headerStorage;
+    std::vector<struct mmsghdr> headers;
+    std::vector<struct iovec> vectors;
+    friend class UDP;
+
+public:
+    int count = 0;
+    OutgoingBatch(int capacity);
+    void add(const char *header, int headerLength, const char *payload = nullptr, int payloadLength = 0);
+    bool full() const { return count == static_cast<int>(headers.size()); }
+};
+
 class UDP
 {
     int sockFd = -1;
     bool opened = false;
     struct addrinfo *endpoint = nullptr;
+    struct addrinfo *addresses = nullptr; // Whole list from getaddrinfo, endpoint is one of them
     UDP(const UDP&) = delete;
+    int receiveMessages(DatagramBatch &batch, int flags);
+    void freeAddresses();
 
 public:
     UDP() {};
     ~UDP();
     int timeoutSeconds;
+    size_t datagramsSent = 0;
+    size_t datagramsReceived = 0;
     int send(const char *sentData, std::size_t length);
     int send(std::string s);
+    /// Sends all queued datagrams and empties the batch. Returns number of sent datagrams
+    int sendBatch(OutgoingBatch &batch);
     int sendWithTimeout(const char *sentData, std::size_t length, int timeout);
     int sendWithTimeout(std::string s, int timeout);
     void createTimeout(int timeout);
+    /// Waits until data can be read. Finer than whole seconds, zero means wait forever
+    void createTimeout(std::chrono::microseconds timeout);
     int createSocket(std::string server, int port);
+    int createMulticastSocket(std::string group, int port);
+    /// Socket bound to a local address for serving requests. Port 0 picks a free one
+    int createServerSocket(std::string address, int port);
+    /// Port the socket is bound to
+    int localPort();
+    /// Sends to whoever sent the last datagram received by the other socket
+    void replyTo(const UDP &other);
+    /// Sends and receives never wait. A datagram which does not fit into the send buffer is dropped
+    void setNonBlocking();
+    int descriptor() const { return sockFd; }
     int receive(char *buffer, int maxLength);
     int receiveWithTimeout(char *buffer, int maxLength, int timeout);
+    int receiveWithTimeout(char *buffer, int maxLength, std::chrono::microseconds timeout);
+    /// Waits for at least one datagram and then takes all already queued ones, up to the batch capacity
+    int receiveBatch(DatagramBatch &batch, std::chrono::microseconds timeout);
+    /// Takes already queued datagrams without waiting. Returns 0 when there are none
+    int receiveAvailable(DatagramBatch &batch);
     int checkTimeout(char *receiveBuffer, int maxLength);
     int getMinimalMTU();
     int close();
@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+#include "ring.hpp"
+#include "sink.hpp"
+
+/// Writes received blocks to the sink from a separate thread, so a slow disk does not delay ACKs.
+/// Block buffers travel to the writer thread and back through two lock-free rings. Neither side polls:
+/// the writer thread sleeps while it has nothing to write, and the network loop is signalled through
+/// an eventfd when it ran out of buffers and one comes back
+class BackgroundWriter
+{
+    struct QueuedBlock
+    {
+        char *buffer;
+        size_t offset;
+        size_t length;
+    };
+
+    Sink &sink;
+    std::vector<char> storage;
+    SpscRing<QueuedBlock> filled; // Network loop -> writer thread
+    SpscRing<char *> free;        // Writer thread -> network loop
+    std::atomic<bool> writerSleeping{false}; // Writer thread waits for filled buffers
+    std::atomic<bool> networkWaiting{false}; // Network loop waits for free buffers
+    int freedFd;                             // Eventfd signalled when a buffer comes back to the waiting loop
+    std::atomic<bool> abandoned{false}; // Destroyed before finish(), queued blocks are dropped
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::thread thread;
+    BackgroundWriter(const BackgroundWriter &) = delete;
+
+    void run();
+    void checkError();
+    /// Queues a buffer for the writer thread and wakes it when it sleeps
+    void queue(const QueuedBlock &block);
+
+public:
+    BackgroundWriter(Sink &sink, int queuedBlocks, int blockSize);
+    ~BackgroundWriter();
+    /// Buffer for one block. nullptr while all buffers are queued for writing (the disk is behind),
+    /// freedDescriptor() becomes readable once one is free again
+    char *tryAcquire();
+    int freedDescriptor() const { return freedFd; }
+    /// Queues a buffer from tryAcquire() to be written at offset
+    void push(char *buffer, size_t offset, size_t length);
+    /// Writes out everything queued and stops the thread. Rethrows an error of the writer thread
+    void finish();
+};
@@ -7,33 +7,48 @@ cxxopts::Options setupArguments()
         options.add_options("Required")
             ("R,Read", "Read file from server. Do not combine with -W")
             ("W,Write", "Write file to server. Do not combine with -R")
-            ("d,file","File path", cxxopts::value<std::string>());
+            ("d,file","File path. Repeat to transfer several files at once", cxxopts::value<std::vector<std::string>>());
         options.add_options("Optional")
-            ("t,timeout", "Timeout in seconds. 0 = no timeout", cxxopts::value<int>()->default_value("0"))
+            ("t,timeout", "Timeout in seconds. 0 = no timeout, a silent server is waited for forever. Otherwise the transfer fails after 5 times that long without an answer", cxxopts::value<int>()->default_value("0"))
             ("s,size","Maximum block size. Default higher bound of block size is the smallest MTU", cxxopts::value<int>())
-            ("m,multicast","Request multicast transfer. Not implemented yet.")
+            ("w,windowsize","Number of blocks sent in a row before waiting for acknowledgement (RFC 7440). 1 = lock-step transfer", cxxopts::value<int>()->default_value("8"))
+            ("r,rollover","Block number which follows 65535 in files of more than 65535 blocks. Most servers roll over to 0, some to 1", cxxopts::value<int>()->default_value("0"))
+            ("b,background","Write received data to disk from a separate thread, so a slow disk does not delay acknowledgements")
+            ("v,verbose","Print every block and acknowledgement instead of a progress report a few times per second")
+            ("coroutine","Read with the coroutine implementation of the transfer")
+            ("m,multicast","Request multicast transfer (RFC 2090) when reading in binary mode.")
+            ("l,list","File with one file path per line to transfer together with -d paths", cxxopts::value<std::string>())
+            ("j,jobs","Number of files transferred at the same time, each in its own session", cxxopts::value<int>()->default_value("4"))
+            ("f,script","File of commands, one per line as typed in the interactive mode. Transfers of all lines run at the same time, -j and -n are taken from the command line", cxxopts::value<std::string>())
+            ("n,threads","Number of threads for transferring more files, each with its own event loop pinned to a core. 0 = one per core", cxxopts::value<int>()->default_value("0"))
             ("c,code","Transfer mode. Can be \"ascii\" (or also \"netascii\") or \"binary\" (or also \"octet\").", cxxopts::value<std::string>()->default_value("binary"))
-            ("a,address","Server address and port formatted: adress,port", cxxopts::value<std::string>()->default_value("127.0.0.1,69"));
+            ("a,address","Server address and port formatted: adress,port", cxxopts::value<std::string>()->default_value("127.0.0.1,69"))
+            ("h,help","Print this help");
         return options;
 }
 
 cxxopts::ParseResult parseArguments(CustomArgLine& separated)
+{
+    return parseArguments(separated.count, separated.separated);
+}
+
+cxxopts::ParseResult parseArguments(int argc, const char *const *argv)
 {
     auto options = setupArguments();
-    return options.parse(separated.count, separated.separated);;
+    return options.parse(argc, argv);
 }
 
 CustomArgLine::~CustomArgLine()
 {
     if (count != 0)
     {
-        count = 0;
         for (int i = 0; i < count; i++)
         {
             delete[] separated[i];
         }
         delete[] separated;
         separated = nullptr;
+        count = 0;
     }
 }
 CustomArgLine::CustomArgLine(std::string line)
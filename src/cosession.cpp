@@ -0,0 +1,243 @@
+#include "cosession.hpp"
+#include "eventloop.hpp"
+#include "log.hpp"
+#include <iostream>
+#include <sys/vfs.h>
+
+#define RECEIVE_BATCH_SIZE 64
+
+bool CoroutineSession::ReceiveAwaiter::await_ready()
+{
+    // Datagrams already waiting are taken without suspending
+    session.receivedCount = session.connection.receiveAvailable(batch);
+    return session.receivedCount > 0;
+}
+
+void CoroutineSession::ReceiveAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    session.listen(true);
+    session.waiting = handle;
+    session.waitingBatch = &batch;
+    session.loop->schedule(session, timeout);
+}
+
+void CoroutineSession::SleepAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    // Datagrams coming meanwhile wait in the socket for the next receive()
+    session.listen(false);
+    session.waiting = handle;
+    session.waitingBatch = nullptr;
+    session.loop->schedule(session, duration);
+}
+
+void CoroutineSession::listen(bool enabled)
+{
+    if (listening != enabled)
+    {
+        loop->listen(connection, enabled);
+        listening = enabled;
+    }
+}
+
+void CoroutineSession::start(EventLoop &loop)
+{
+    this->loop = &loop;
+    task = body();
+    task.start();
+    checkFinished();
+}
+
+void CoroutineSession::readable(UDP &socket)
+{
+    if (!waiting || waitingBatch == nullptr)
+    {
+        return;
+    }
+    receivedCount = socket.receiveAvailable(*waitingBatch);
+    if (receivedCount != 0)
+    {
+        resume();
+    }
+}
+
+void CoroutineSession::expired()
+{
+    if (waiting)
+    {
+        receivedCount = 0;
+        resume();
+    }
+}
+
+void CoroutineSession::resume()
+{
+    std::exchange(waiting, nullptr).resume();
+    checkFinished();
+}
+
+void CoroutineSession::checkFinished()
+{
+    if (task.done())
+    {
+        TransferResult result = task.result(); // Rethrows what the transfer threw
+        if (result.succeeded)
+        {
+            complete(result.bytes);
+        }
+        else
+        {
+            fail(result.error, result.code, result.serverCode);
+        }
+    }
+}
+
+void CoroutineSession::release()
+{
+    task.reset(); // Frees the coroutine frame, also of a failed transfer
+    Session::release();
+}
+
+Task<TransferResult> CoroutineReadSession::read()
+{
+    connect();
+    sink = options.sink;
+    if (sink == nullptr)
+    {
+        struct statfs64 fileSystemInfo;
+        auto fileBaseName = base_name(options.filePath);
+        ownedSink = std::make_unique<MappedFileSink>(fileBaseName);
+        sink = ownedSink.get();
+        statfs64(fileBaseName.c_str(), &fileSystemInfo);//Get free disk space
+        logInfo() << "There are " << fileSystemInfo.f_bsize * fileSystemInfo.f_bfree << " free bytes on disk";
+    }
+    if (options.multicast)
+    {
+        printError("Multicast is not supported by coroutine reads. Requesting unicast transfer.");
+        options.multicast = false;
+    }
+
+    logInfo() << "Sending read file request with " << options.mode << " mode";
+    tftp.sendRRQ(connection, options.filePath, options.mode, blockSizeOffer, options.timeoutOffer, options.windowSizeOffer);
+    tftp.roundTrip().sent();
+
+    DatagramBatch batch(std::min(options.windowSizeOffer, RECEIVE_BATCH_SIZE), std::max(blockSizeOffer, blocksize) + 4);
+    OutgoingBatch acks(batch.capacity());
+    SequenceTracker sequence;    // Blocks are written in order, so only the next block is new
+    uint64_t lastAckedBlock = 0; // Server sends windowsize blocks after each ACK (RFC 7440)
+    int outOfOrderCount = 0;     // Duplicate or unexpected blocks since the last progress
+    size_t written = 0;
+    bool answered = false;   // Server replied to the request
+    while (true)
+    {
+        if (co_await receive(batch, tftp.retransmitTimeout()) == 0)
+        {
+            if (!tftp.roundTrip().backoff())
+            {
+                throw TimeoutException();
+            }
+            if (!answered)
+            {
+                logInfo() << "Timeout. Sending read file request again.";
+                tftp.sendRRQ(connection, options.filePath, options.mode, blockSizeOffer, options.timeoutOffer, options.windowSizeOffer);
+            }
+            else
+            {
+                logInfo() << "Timeout. Sending ACK for " << sequence.lastInOrder() << " again.";
+                tftp.queueACK(acks, sequence.lastInOrder());
+                co_await send(acks);
+            }
+            tftp.roundTrip().sent(true);
+            continue;
+        }
+
+        for (int i = 0; i < batch.count; i++)
+        {
+            PacketView packet(batch.datagram(i), batch.length(i), batch.payload(i));
+            if (packet.is(Opcode::OACK) && sequence.lastInOrder() != 0)
+            {
+                // A late or duplicated OACK. ACK 0 would make the server start the window from block 1 again
+                tftp.queueACK(acks, sequence.lastInOrder());
+                continue;
+            }
+            if (applyOACK(packet))
+            {
+                if (!answered)
+                {
+                    answered = true;
+                    tftp.roundTrip().answered();
+                    if (transferSize != 0 && !sink->preallocate(transferSize))
+                    {
+                        tftp.sendERROR(connection, 3, "Disk full or allocation exceeded");
+                        throw TransferException(TransferError::DiskFull, "Not enough free space on disk for " + std::to_string(transferSize) + " bytes.");
+                    }
+                    logInfo() << "Sending ACK to OACK";
+                }
+                // A repeated OACK before any block means our ACK was lost
+                tftp.queueACK(acks, 0);
+                continue;
+            }
+            if (packet.is(Opcode::ERROR))
+            {
+                throwServerError(packet);
+            }
+            if (!packet.is(Opcode::DATA))
+            {
+                printError("Warning: Received packet which supposet to be DATA packet with unusual opcode");
+                continue;
+            }
+            answered = true;
+
+            uint64_t blockNumber = tftp.blockNumber(packet.blockNumber(), sequence.lastInOrder());
+            logEvent(LogLevel::Debug, LogEvent::BlockReceived, packet.size(), blockNumber);
+            if (sequence.receive(blockNumber) != SequenceTracker::Arrival::New)
+            {
+                // Retransmitted block or a gap in the window, answered once per window
+                // with ACK of the last block received in order
+                if (outOfOrderCount++ % windowsize == 0)
+                {
+                    logEvent(LogLevel::Debug, LogEvent::AckResent, sequence.lastInOrder());
+                    tftp.queueACK(acks, sequence.lastInOrder());
+                    tftp.roundTrip().sent(true);
+                    lastAckedBlock = sequence.lastInOrder();
+                }
+                continue;
+            }
+
+            bool finished = packet.size() < blocksize + 4;
+            auto fileBytes = tftp.decodePayload(batch.payload(i), batch.payloadLength(i), finished);
+            sink->write(written, fileBytes.data(), fileBytes.size());
+            written += fileBytes.size();
+            outOfOrderCount = 0;
+            tftp.roundTrip().answered();
+
+            if (finished || blockNumber - lastAckedBlock >= static_cast<uint64_t>(windowsize))
+            {
+                tftp.queueACK(acks, blockNumber);
+                logEvent(LogLevel::Debug, LogEvent::AckSent, blockNumber);
+                lastAckedBlock = blockNumber;
+            }
+            if (finished)
+            {
+                co_await send(acks);
+                sink->close(written);
+                TransferResult result;
+                result.succeeded = true;
+                result.bytes = written;
+                co_return result;
+            }
+        }
+        if (acks.count != 0)
+        {
+            tftp.roundTrip().sent();
+            co_await send(acks);
+        }
+        progress.update(written, transferSize);
+    }
+}
+
+void CoroutineReadSession::release()
+{
+    CoroutineSession::release();
+    ownedSink.reset();
+    sink = nullptr;
+}
@@ -0,0 +1,116 @@
+#include "engine.hpp"
+#include <pthread.h>
+#include <sched.h>
+
+#define INBOX_CAPACITY 1024
+
+ShardedEngine::Shard::Shard() : inbox(INBOX_CAPACITY)
+{
+}
+
+ShardedEngine::ShardedEngine(int shardCount)
+{
+    // Only the cores this process may run on
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    std::vector<int> cpus;
+    if (sched_getaffinity(0, sizeof allowed, &allowed) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &allowed))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    if (shardCount <= 0)
+    {
+        shardCount = std::max<int>(cpus.size(), 1);
+    }
+    for (int i = 0; i < shardCount; i++)
+    {
+        shards.push_back(std::make_unique<Shard>());
+    }
+    for (int i = 0; i < shardCount; i++)
+    {
+        // More shards than cores share the cores round-robin
+        int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        shards[i]->thread = std::thread(&ShardedEngine::runShard, this, std::ref(*shards[i]), cpu);
+    }
+}
+
+ShardedEngine::~ShardedEngine()
+{
+    stopping.store(true, std::memory_order_release);
+    for (auto &shard : shards)
+    {
+        shard->loop.wake();
+        shard->thread.join();
+    }
+}
+
+void ShardedEngine::runShard(Shard &shard, int cpu)
+{
+    if (cpu != -1)
+    {
+        // Not being pinned only costs cache locality, so a failure is ignored
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof set, &set);
+    }
+    shard.loop.onFinished = [this, &shard](Session &) {
+        shard.load.fetch_sub(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mutex);
+        finishedCount++;
+        sessionFinished.notify_one();
+    };
+    while (!stopping.load(std::memory_order_acquire))
+    {
+        // Sessions are started (and allocate their buffers) in the thread which will use them
+        Session *session;
+        while (shard.inbox.pop(session))
+        {
+            shard.loop.start(*session);
+        }
+        shard.loop.poll();
+    }
+}
+
+void ShardedEngine::submit(Session &session)
+{
+    Shard *target = shards[0].get();
+    for (auto &shard : shards)
+    {
+        if (shard->load.load(std::memory_order_relaxed) < target->load.load(std::memory_order_relaxed))
+        {
+            target = shard.get();
+        }
+    }
+    target->load.fetch_add(1, std::memory_order_relaxed);
+    while (!target->inbox.push(&session))
+    {
+        std::this_thread::yield();
+    }
+    target->loop.wake();
+}
+
+void ShardedEngine::run(std::vector<std::unique_ptr<Session>> &sessions, int concurrency)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    finishedCount = 0;
+    size_t next = 0;
+    while (finishedCount < sessions.size())
+    {
+        while (next < sessions.size() && next - finishedCount < static_cast<size_t>(concurrency))
+        {
+            // Sessions finishing meanwhile wait for the lock, so they are not missed
+            lock.unlock();
+            submit(*sessions[next++]);
+            lock.lock();
+        }
+        size_t seen = finishedCount;
+        sessionFinished.wait(lock, [&]() { return finishedCount != seen || finishedCount == sessions.size(); });
+    }
+}
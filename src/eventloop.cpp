@@ -0,0 +1,241 @@
+#include "eventloop.hpp"
+#include "log.hpp"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define MAX_EVENTS 64
+
+EventLoop::EventLoop()
+{
+    if ((epollFd = epoll_create1(EPOLL_CLOEXEC)) == -1)
+    {
+        throw UDPException(errno, " encountered while creating epoll instance");
+    }
+    if ((wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+    {
+        throw UDPException(errno, " encountered while creating eventfd");
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event) == -1)
+    {
+        throw UDPException(errno, " encountered while watching eventfd");
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    ::close(wakeFd);
+    ::close(epollFd);
+}
+
+void EventLoop::wake()
+{
+    uint64_t one = 1;
+    if (::write(wakeFd, &one, sizeof one) == -1 && errno != EAGAIN)
+    {
+        throw UDPException(errno, " encountered while waking event loop");
+    }
+}
+
+void EventLoop::watch(Session &session, UDP &socket)
+{
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = socket.descriptor();
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, socket.descriptor(), &event) == -1)
+    {
+        throw UDPException(errno, " encountered while watching a socket");
+    }
+    watched[socket.descriptor()] = {&session, &socket};
+    session.sockets.push_back(&socket);
+}
+
+void EventLoop::watchSignal(Session &session, int descriptor)
+{
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = descriptor;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, descriptor, &event) == -1)
+    {
+        throw UDPException(errno, " encountered while watching eventfd");
+    }
+    signals[descriptor] = &session;
+    session.signalDescriptors.push_back(descriptor);
+}
+
+void EventLoop::listen(UDP &socket, bool enabled)
+{
+    struct epoll_event event;
+    event.events = enabled ? EPOLLIN : 0;
+    event.data.fd = socket.descriptor();
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, socket.descriptor(), &event) == -1)
+    {
+        throw UDPException(errno, " encountered while changing a watched socket");
+    }
+}
+
+void EventLoop::schedule(Session &session, std::chrono::microseconds after)
+{
+    // Rearming moves the existing node of the session, so a transfer does not allocate per block
+    auto node = timers.extract({session.deadline, &session});
+    session.deadline = std::chrono::steady_clock::now() + after;
+    if (node.empty())
+    {
+        timers.insert({session.deadline, &session});
+        return;
+    }
+    node.value() = {session.deadline, &session};
+    timers.insert(std::move(node));
+}
+
+void EventLoop::start(Session &session)
+{
+    active++;
+    session.startedAt = std::chrono::steady_clock::now();
+    session.logName = internLogName(session.name);
+    sessionName = session.logName;
+    try
+    {
+        session.start(*this);
+    }
+    catch (const std::exception &e)
+    {
+        session.fail(e);
+    }
+    sessionName = "";
+    if (session.finished())
+    {
+        retire(session);
+    }
+}
+
+void EventLoop::deliver(Session &session, UDP *socket, bool signalled)
+{
+    sessionName = session.logName;
+    try
+    {
+        if (signalled)
+        {
+            session.signalled();
+        }
+        else if (socket != nullptr)
+        {
+            session.readable(*socket);
+        }
+        else
+        {
+            session.expired();
+        }
+    }
+    catch (const std::exception &e)
+    {
+        session.fail(e);
+    }
+    sessionName = "";
+    if (session.finished())
+    {
+        retire(session);
+    }
+}
+
+void EventLoop::retire(Session &session)
+{
+    active--;
+    session.finishedAt = std::chrono::steady_clock::now();
+    timers.erase({session.deadline, &session});
+    for (auto socket : session.sockets)
+    {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, socket->descriptor(), nullptr);
+        watched.erase(socket->descriptor());
+    }
+    session.sockets.clear();
+    for (int descriptor : session.signalDescriptors)
+    {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, descriptor, nullptr);
+        signals.erase(descriptor);
+    }
+    session.signalDescriptors.clear();
+    // Thousands of finished sessions must not keep their descriptors and buffers
+    session.release();
+    if (onFinished)
+    {
+        onFinished(session);
+    }
+    releaseLogName(session.logName);
+    session.logName = "";
+}
+
+void EventLoop::poll()
+{
+    struct epoll_event events[MAX_EVENTS];
+    int waitMs = -1;
+    if (!timers.empty())
+    {
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(timers.begin()->first - std::chrono::steady_clock::now());
+        waitMs = std::max<long>(remaining.count(), 0);
+    }
+    int count = epoll_wait(epollFd, events, MAX_EVENTS, waitMs);
+    if (count == -1)
+    {
+        if (errno == EINTR)
+        {
+            return;
+        }
+        throw UDPException(errno, " encountered while waiting for events");
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (events[i].data.fd == wakeFd)
+        {
+            uint64_t value;
+            while (::read(wakeFd, &value, sizeof value) > 0)
+            {
+            }
+            continue;
+        }
+        // An earlier event of this round may have retired the session
+        auto signal = signals.find(events[i].data.fd);
+        if (signal != signals.end())
+        {
+            uint64_t value;
+            while (::read(events[i].data.fd, &value, sizeof value) > 0)
+            {
+            }
+            deliver(*signal->second, nullptr, true);
+            continue;
+        }
+        auto found = watched.find(events[i].data.fd);
+        if (found != watched.end())
+        {
+            deliver(*found->second.first, found->second.second);
+        }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    while (!timers.empty() && timers.begin()->first <= now)
+    {
+        Session *session = timers.begin()->second;
+        timers.erase(timers.begin());
+        deliver(*session, nullptr);
+    }
+}
+
+void EventLoop::run(std::vector<std::unique_ptr<Session>> &sessions, int concurrency)
+{
+    size_t next = 0;
+    while (true)
+    {
+        while (active < concurrency && next < sessions.size())
+        {
+            start(*sessions[next++]);
+        }
+        if (active == 0)
+        {
+            return;
+        }
+        poll();
+    }
+}
@@ -0,0 +1,401 @@
+#include "log.hpp"
+#include "ring.hpp"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+#define LOG_RING_SIZE 8192         // Records per thread
+#define LOG_WRITE_INTERVAL 20ms    // Longest time a message waits for the logging thread
+#define LOG_REORDER_DELAY 20ms     // Messages of different threads younger than this wait for older ones
+
+/// Compact message as recorded by the network loop
+struct LogRecord
+{
+    std::chrono::system_clock::time_point time;
+    const char *session;
+    std::string *text; // Message of LogEvent::Text, deleted when written
+    int64_t first;
+    int64_t second;
+    LogLevel level;
+    LogEvent event;
+    bool releasesName = false; // Not a message, the session name is released once everything before is written
+};
+
+/// Interned session names with the number of their uses
+struct LogNames
+{
+    std::mutex lock;
+    std::map<std::string, size_t> uses;
+};
+
+/// Records of one thread
+struct LogRing
+{
+    SpscRing<LogRecord> records{LOG_RING_SIZE};
+    std::atomic<size_t> dropped{0};
+    std::atomic<bool> retired{false}; // The thread ended, the ring is freed once it is empty
+};
+
+/// Retires the ring of a thread when the thread ends
+struct LogRingOwner
+{
+    LogRing *ring = nullptr;
+    ~LogRingOwner();
+};
+
+/// Owns the rings of all threads and the thread which writes their records
+class Logger
+{
+    std::mutex ringsLock;
+    std::vector<std::unique_ptr<LogRing>> rings;
+    std::mutex wakeLock;
+    std::condition_variable wake;    // Logging thread waits here for records
+    std::condition_variable written; // flushLog() waits here for the logging thread
+    bool stopping = false;
+    size_t flushRequests = 0; // Flushes asked for so far
+    size_t flushed = 0;       // Flushes done, each writes every record recorded before it was asked for
+    std::thread thread;
+
+    // Used only by the logging thread
+    std::vector<LogRecord> pending; // Taken from the rings, ordered by time and not written yet
+    std::string output;
+    FILE *outputStream = stdout;
+    time_t cachedSecond = -1;
+    char cachedPrefix[32]; // "[YYYY-mm-dd HH:MM:SS." of cachedSecond
+
+    void run();
+    /// Takes records of all rings and writes them in the order of their time. Unless all is set, the youngest
+    /// records wait for the next call, so an older record of a thread which was just late comes before them
+    void drain(bool all);
+    void format(const LogRecord &record);
+    void write(FILE *stream);
+
+public:
+    Logger();
+    ~Logger();
+    LogRing &ring();
+    void flush();
+};
+
+Logger &logger();
+LogNames &logNames();
+void appendNumber(std::string &output, int64_t number);
+
+thread_local const char *sessionName = "";
+std::atomic<LogLevel> logLevel{LogLevel::Info};
+
+Logger::Logger()
+{
+    // Interned names are read until the last record is written, so they must be destroyed after the logger
+    logNames();
+    thread = std::thread(&Logger::run, this);
+}
+
+Logger::~Logger()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeLock);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+LogRing &Logger::ring()
+{
+    thread_local LogRingOwner own;
+    if (own.ring == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(ringsLock);
+        rings.push_back(std::make_unique<LogRing>());
+        own.ring = rings.back().get();
+    }
+    return *own.ring;
+}
+
+LogRingOwner::~LogRingOwner()
+{
+    if (ring != nullptr)
+    {
+        ring->retired.store(true, std::memory_order_release);
+    }
+}
+
+void Logger::run()
+{
+    while (true)
+    {
+        size_t request;
+        bool stop;
+        {
+            std::unique_lock<std::mutex> lock(wakeLock);
+            wake.wait_for(lock, LOG_WRITE_INTERVAL, [this]() { return stopping || flushRequests != flushed; });
+            request = flushRequests;
+            stop = stopping;
+        }
+        drain(stop || request != flushed);
+        {
+            std::lock_guard<std::mutex> lock(wakeLock);
+            flushed = request;
+        }
+        written.notify_all();
+        if (stop)
+        {
+            break;
+        }
+    }
+}
+
+void Logger::drain(bool all)
+{
+    std::vector<LogRing *> current;
+    {
+        std::lock_guard<std::mutex> lock(ringsLock);
+        for (auto &ring : rings)
+        {
+            current.push_back(ring.get());
+        }
+    }
+    size_t dropped = 0;
+    std::vector<LogRing *> empty; // Rings of ended threads with nothing left
+    size_t taken = pending.size();
+    for (auto *ring : current)
+    {
+        // Checked first: the thread does not record anything after it retired the ring
+        bool retired = ring->retired.load(std::memory_order_acquire);
+        LogRecord record;
+        while (ring->records.pop(record))
+        {
+            pending.push_back(record);
+        }
+        dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+        if (retired)
+        {
+            empty.push_back(ring);
+        }
+    }
+
+    // Each ring is in order already, records of different threads are interleaved by time
+    if (pending.size() != taken)
+    {
+        std::stable_sort(pending.begin(), pending.end(), [](const LogRecord &a, const LogRecord &b) { return a.time < b.time; });
+    }
+    auto cutoff = std::chrono::system_clock::now() - LOG_REORDER_DELAY;
+    size_t count = 0;
+    while (count < pending.size() && (all || pending[count].time <= cutoff))
+    {
+        if (pending[count].releasesName)
+        {
+            auto &names = logNames();
+            std::lock_guard<std::mutex> lock(names.lock);
+            auto name = names.uses.find(pending[count].session);
+            if (name != names.uses.end() && --name->second == 0)
+            {
+                names.uses.erase(name);
+            }
+        }
+        else
+        {
+            format(pending[count]);
+        }
+        delete pending[count].text;
+        count++;
+    }
+    pending.erase(pending.begin(), pending.begin() + count);
+    if (dropped != 0)
+    {
+        write(outputStream);
+        outputStream = stderr;
+        output.append("[log] ");
+        appendNumber(output, dropped);
+        output.append(" messages dropped, the terminal is too slow\n");
+    }
+    write(outputStream);
+
+    if (!empty.empty())
+    {
+        std::lock_guard<std::mutex> lock(ringsLock);
+        std::erase_if(rings, [&](const std::unique_ptr<LogRing> &ring) { return std::find(empty.begin(), empty.end(), ring.get()) != empty.end(); });
+    }
+}
+
+void Logger::format(const LogRecord &record)
+{
+    FILE *stream = record.level == LogLevel::Error ? stderr : stdout;
+    if (stream != outputStream)
+    {
+        // Keep the order of messages on both streams
+        write(outputStream);
+        outputStream = stream;
+    }
+
+    // Date and time change only once per second, so only milliseconds are formatted for each message
+    auto sinceEpoch = record.time.time_since_epoch();
+    time_t second = std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch).count();
+    if (second != cachedSecond)
+    {
+        struct tm local;
+        localtime_r(&second, &local);
+        strftime(cachedPrefix, sizeof cachedPrefix, "[%Y-%m-%d %H:%M:%S.", &local);
+        cachedSecond = second;
+    }
+    int ms = std::chrono::duration_cast<std::chrono::milliseconds>(sinceEpoch).count() % 1000;
+    char milliseconds[] = {static_cast<char>('0' + ms / 100), static_cast<char>('0' + ms / 10 % 10), static_cast<char>('0' + ms % 10), ']', ' '};
+    output.append(cachedPrefix).append(milliseconds, sizeof milliseconds);
+    if (record.session[0] != '\0')
+    {
+        output.append(record.session).append(": ");
+    }
+
+    switch (record.event)
+    {
+    case LogEvent::Text:
+        output.append(*record.text);
+        break;
+    case LogEvent::BlockReceived:
+        output.append("Received ");
+        appendNumber(output, record.first);
+        output.append(" bytes DATA packet with block number ");
+        appendNumber(output, record.second);
+        break;
+    case LogEvent::BlockSent:
+        output.append("Sending ");
+        appendNumber(output, record.first);
+        output.append(" bytes DATA block ");
+        appendNumber(output, record.second);
+        break;
+    case LogEvent::AckReceived:
+        output.append("Received ACK to block ");
+        appendNumber(output, record.first);
+        break;
+    case LogEvent::AckSent:
+        output.append("Sending ACK to block ");
+        appendNumber(output, record.first);
+        break;
+    case LogEvent::AckResent:
+        output.append("Sending ACK for ");
+        appendNumber(output, record.first);
+        output.append(" again.");
+        break;
+    case LogEvent::WindowResent:
+        output.append("Sending blocks from ");
+        appendNumber(output, record.first);
+        output.append(" again.");
+        break;
+    }
+    output.push_back('\n');
+}
+
+void appendNumber(std::string &output, int64_t number)
+{
+    char digits[24];
+    auto converted = std::to_chars(digits, digits + sizeof digits, number);
+    output.append(digits, converted.ptr - digits);
+}
+
+void Logger::write(FILE *stream)
+{
+    if (!output.empty())
+    {
+        fwrite(output.data(), 1, output.size(), stream);
+        fflush(stream);
+        output.clear();
+    }
+}
+
+void Logger::flush()
+{
+    std::unique_lock<std::mutex> lock(wakeLock);
+    size_t request = ++flushRequests;
+    wake.notify_one();
+    written.wait(lock, [&]() { return flushed >= request || stopping; });
+}
+
+Logger &logger()
+{
+    static Logger instance;
+    return instance;
+}
+
+void setLogLevel(LogLevel level)
+{
+    logLevel.store(level, std::memory_order_relaxed);
+}
+
+void logText(LogLevel level, std::string text)
+{
+    if (!logEnabled(level))
+    {
+        return;
+    }
+    auto &ring = logger().ring();
+    auto *message = new std::string(std::move(text));
+    if (!ring.records.push({std::chrono::system_clock::now(), sessionName, message, 0, 0, level, LogEvent::Text}))
+    {
+        delete message;
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void logEvent(LogLevel level, LogEvent event, int64_t first, int64_t second)
+{
+    if (!logEnabled(level))
+    {
+        return;
+    }
+    auto &ring = logger().ring();
+    if (!ring.records.push({std::chrono::system_clock::now(), sessionName, nullptr, first, second, level, event}))
+    {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void flushLog()
+{
+    logger().flush();
+}
+
+LogNames &logNames()
+{
+    static LogNames names;
+    return names;
+}
+
+const char *internLogName(const std::string &name)
+{
+    auto &names = logNames();
+    std::lock_guard<std::mutex> lock(names.lock);
+    auto interned = names.uses.try_emplace(name, 0).first;
+    interned->second++;
+    return interned->first.c_str();
+}
+
+void releaseLogName(const char *name)
+{
+    // Recorded in the same ring as the messages of the name, so it comes after them, even when logging
+    // is off. When the ring is full, the name is kept rather than freed too early
+    logger().ring().records.push({std::chrono::system_clock::now(), name, nullptr, 0, 0, LogLevel::Off, LogEvent::Text, true});
+}
+
+LogLine::~LogLine()
+{
+    if (logEnabled(level))
+    {
+        logText(level, stream.str());
+    }
+}
+
+void printError(std::string error)
+{
+    logText(LogLevel::Error, std::move(error));
+}
@@ -1,28 +1,27 @@
-#define DEFAULT_BLOCK_SIZE 512
-
 #include <iostream>
 #include <iomanip>
 #include <fstream>
-#include <ctime>
 #include <chrono>
 #include <vector>
-#include <sys/stat.h>
-#include <sys/vfs.h>
+#include <memory>
 #include "cxxopts.hpp"
 #include "arguments.hpp"
-#include "udp.hpp"
-#include "tftp.hpp"
+#include "log.hpp"
+#include "strhash.hpp"
+#include "session.hpp"
+#include "eventloop.hpp"
+#include "engine.hpp"
+
+// Exit status of a command given on the process command line. A failed transfer exits with
+// EXIT_TRANSFER_FAILED + TransferError of the first failed file
+#define EXIT_OK 0
+#define EXIT_USAGE 1
+#define EXIT_TRANSFER_FAILED 1
+#define EXIT_STATUS_HELP \
+    "Exit status: 0 all files transferred, 1 invalid command, 2 timeout, 3 error reported by server,\n" \
+    "             4 disk full, 5 local file error, 6 network error, 7 protocol error\n"
 
-void printTimestamp();
-void printError(std::string error);
-long GetFileSize(std::string filename);
-std::string base_name(std::string const &path);
-bool checkOACKs(char *buffer, int recvBytesCount, UDP &connection, int timeoutOffer, int &timeout, int blocksizeOffer, int &blocksize, long unsigned int &transferSize, bool read);
 unsigned int stdStr2intHash(std::string str, int h = 0);
-constexpr unsigned int str2intHash(const char *str, int h = 0)
-{
-    return !str[h] ? 5381 : (str2intHash(str, h + 1) * 33) ^ str[h];
-}
 struct ServerConfig
 {
     std::string server;
@@ -31,25 +30,51 @@ struct ServerConfig
 struct SkipToNextUserInput
 {
 };
-template <typename T>
-T requiredArgumentGet(cxxopts::ParseResult argumentsResult, std::string argumentName);
+std::vector<std::string> collectFilePaths(const cxxopts::ParseResult &argumentsResult);
+TransferOptions makeTransferOptions(const cxxopts::ParseResult &argumentsResult, const std::string &filePath);
+void addTransfers(const cxxopts::ParseResult &argumentsResult, std::vector<std::unique_ptr<Session>> &sessions, std::vector<std::string> &filePaths);
+void addScriptTransfers(const std::string &scriptPath, std::vector<std::unique_ptr<Session>> &sessions, std::vector<std::string> &filePaths);
+void checkDistinctBaseNames(const std::vector<std::string> &filePaths);
+int runCommand(const cxxopts::ParseResult &argumentsResult);
+int transferFiles(const cxxopts::ParseResult &argumentsResult, std::vector<std::unique_ptr<Session>> &sessions, const std::vector<std::string> &filePaths);
+int exitStatus(const std::vector<std::unique_ptr<Session>> &sessions);
 ServerConfig parseServerConfig(std::string confString);
-template <typename T, typename U, typename V>
-bool checkOptionError(T optionValue, U serverValue, V optionName);
-int main()
+int main(int argc, char **argv)
 {
+    if (argc > 1)
+    {
+        // One-shot mode: run the command given on the command line and report the result in the exit status
+        try
+        {
+            return runCommand(parseArguments(argc, argv));
+        }
+        catch (const std::exception &e)
+        {
+            printError(e.what());
+            return EXIT_USAGE;
+        }
+        catch (const SkipToNextUserInput &e)
+        {
+            return EXIT_USAGE;
+        }
+    }
+
     std::cout << "My TFTP Client. Enter 'q' to quit or 'h' for help." << std::endl;
     bool quit = false;
     while (!quit)
     {
         try
         {
+            flushLog(); // Messages of the last command come before the prompt
             std::cout << "> ";
 
             // Scan user input
             std::string line;
             std::cin.clear();
-            std::getline(std::cin, line);
+            if (!std::getline(std::cin, line))
+            {
+                break;
+            }
             switch (stdStr2intHash(line))
             {
             case str2intHash("q"):
@@ -64,162 +89,7 @@ int main()
             CustomArgLine separated = CustomArgLine(line);
 
             // Process user input
-            auto argumentsResult = parseArguments(separated);
-
-            UDP connection;
-            int timeout = 0;
-            TFTP tftp(timeout);
-            ServerConfig serverConfig = parseServerConfig(argumentsResult["a"].as<std::string>());
-            std::string mode = argumentsResult["c"].as<std::string>();
-            std::vector<std::string> permittedModes = {"ascii", "octet", "netascii", "binary"};
-
-            if (std::find(permittedModes.begin(), permittedModes.end(), mode) == permittedModes.end())
-            {
-                printError("Unknown transfer mode specified, but trying to use it...");
-            }
-            std::string filePath = requiredArgumentGet<std::string>(argumentsResult, "d");
-
-            printTimestamp();
-            std::cout << "Creating connection to server " << serverConfig.server << " port " << serverConfig.port << std::endl;
-            connection.createSocket(serverConfig.server, serverConfig.port);
-
-            int minimalMTU = connection.getMinimalMTU();
-            int blockSizeOffer = DEFAULT_BLOCK_SIZE;
-            int blocksize = DEFAULT_BLOCK_SIZE;
-            long unsigned int transferSize = 0;
-            int timeoutOffer = argumentsResult["t"].as<int>();
-            if (argumentsResult.count("s") == 1)
-            {
-                blockSizeOffer = std::min(argumentsResult["s"].as<int>(), minimalMTU);
-                printTimestamp();
-                std::cout << "Minimal MTU of all network interfaces is " << minimalMTU << ". Blocksize set to " << blockSizeOffer << std::endl;
-            }
-
-            // BEGIN SERVER COMMUNICATION
-            if (argumentsResult.count("R") == 1)
-            {
-                //Read branch
-                if (argumentsResult.count("W"))
-                {
-                    printError("Do not combine Read and Write arguments.");
-                    continue;
-                }
-                struct statfs64 fileSystemInfo;
-                auto fileBaseName = base_name(filePath);
-                std::ofstream file(fileBaseName);
-                statfs64(fileBaseName.c_str(), &fileSystemInfo);//Get free disk space
-                printTimestamp();
-                std::cout << "There are " << fileSystemInfo.f_bsize * fileSystemInfo.f_bfree << " free bytes on disk" << std::endl;
-
-                printTimestamp();
-                std::cout << "Sending read file request with " << mode << " mode" << std::endl;
-                tftp.sendRRQ(connection, filePath, mode, blockSizeOffer, timeoutOffer);
-
-                char *buffer = new char[std::max(blockSizeOffer, blocksize) + 4]; //+4 because 2 bytes for opcode and 2 bytes for the block number
-                int recvBytesCount = 0;
-
-                char *lastMessage = new char[std::max(blockSizeOffer, blocksize) + 4];
-                int lastRecvBytesCount = 0;
-                int lastBlockNumber = 0;
-                std::string lastSentAck;
-                bool gotOACK = false;
-                do
-                {
-                    gotOACK = false;
-                    //Receive, apply timeout, and transfer mode
-                    int fileBytesCount = tftp.receive(connection, buffer, blocksize + 4, recvBytesCount);
-
-                    // Receive option acknowledgements (OACKs)
-                    // This function also updates corresponding option values
-                    if (checkOACKs(buffer, recvBytesCount, connection, timeoutOffer, timeout, blockSizeOffer, blocksize, transferSize, true))
-                    {
-                        //If received an OACK, server accepted the offer
-                        //Continue with receiving
-                        gotOACK = true;
-                        printTimestamp();
-                        if (fileSystemInfo.f_bfree * fileSystemInfo.f_bsize >= transferSize)//Check if there is enough disk space
-                        {
-                            std::cout << "Sending ACK to OACK" << std::endl;
-                            connection.send(tftp.makeACK(std::string({'\0', '\0'})));
-                        }
-                        continue;
-                    }
-
-                    //Check for DATA packet opcode
-                    std::string blockNumberString({static_cast<char>(buffer[2] + '0'), static_cast<char>(buffer[3] + '0')});
-                    std::istringstream bntoInt(blockNumberString);
-                    int blockNumber;
-                    bntoInt >> blockNumber;
-                    std::string packetOpcode({static_cast<char>(buffer[0] + '0'), static_cast<char>(buffer[1] + '0')});
-                    printTimestamp();
-                    std::cout << "Received " << recvBytesCount << " bytes packet with opcode " << packetOpcode << " with block number " << blockNumberString << std::endl;
-
-                    //Check for error packet
-                    if (packetOpcode == "05")
-                    {
-                        std::ostringstream errOutput;
-                        errOutput << "Server send an error packet. Contents:" << std::endl;
-                        errOutput.write(buffer + 4, recvBytesCount - 4);
-                        printError(errOutput.str());
-                        throw SkipToNextUserInput();
-                    }
-                    else if (packetOpcode != "03")
-                    {
-                        printError("Warning: Received packet which supposet to be DATA packet with unusual opcode");
-                    }
-
-                    if (blockNumber == lastBlockNumber + 1) //Block numbers should increase with 1
-                    {
-                        // WRITE to the file
-                        file.write(buffer + 4, fileBytesCount); //Because the first 4 bytes are the block number
-
-                        // Send acknowledgment packet
-                        std::string ackMessage = tftp.makeACK({buffer[2], buffer[3]});
-                        int sentBytes = connection.send(ackMessage);
-                        printTimestamp();
-                        std::cout << "Sent " << sentBytes << " bytes ACK to block " << blockNumberString << std::endl;
-                        lastSentAck = ackMessage;
-                        std::memcpy(lastMessage, buffer, recvBytesCount);
-                        lastBlockNumber = blockNumber;
-                        lastRecvBytesCount = recvBytesCount;
-                    }
-                    else
-                    {
-                        if (recvBytesCount == lastRecvBytesCount && std::memcmp(buffer, lastMessage, recvBytesCount) == 0)
-                        {
-                            //SEND LAST ACK AGAIN - as it probably didn't reach the server
-                            printTimestamp();
-                            std::cout << "Sending ACK for " << lastBlockNumber << " again." << std::endl;
-                            connection.send(lastSentAck);
-                            continue; //Receive next block
-                        }
-
-                        // In this place the block number is out of sync, so we must abort the transfer
-                        std::cerr << "Expected " << (lastBlockNumber + 1) << " but got " << blockNumber << std::endl;
-                        printError("Block number out of sync.");
-                    }
-                } while (gotOACK || recvBytesCount == blocksize + 4 || recvBytesCount == blockSizeOffer + 4);
-                delete[] buffer;
-                delete[] lastMessage;
-            }
-            else if (argumentsResult.count("W") == 1)
-            {
-                //Write branch
-                if (argumentsResult.count("R"))
-                {
-                    printError("Do not combine Read and Write arguments.");
-                    continue;
-                }
-            }
-            else
-            {
-                printError("Specify either -R for Read or -W for Write file mode.");
-                continue;
-            }
-
-            connection.close();
-            printTimestamp();
-            std::cout << "Connection finished." << std::endl;
+            runCommand(parseArguments(separated));
         }
         catch (const std::exception &e)
         {
@@ -236,173 +106,271 @@ int main()
     return 0;
 }
 
-std::string base_name(std::string const &path)
+std::vector<std::string> collectFilePaths(const cxxopts::ParseResult &argumentsResult)
 {
-    //https://stackoverflow.com/questions/8520560/get-a-file-name-from-a-path
-    return path.substr(path.find_last_of("/\\") + 1);
+    std::vector<std::string> filePaths;
+    if (argumentsResult.count("d") != 0)
+    {
+        filePaths = argumentsResult["d"].as<std::vector<std::string>>();
+    }
+    if (argumentsResult.count("l") == 1)
+    {
+        std::string listPath = argumentsResult["l"].as<std::string>();
+        std::ifstream list(listPath);
+        if (!list)
+        {
+            printError("Cannot open file list " + listPath + ".");
+            throw SkipToNextUserInput();
+        }
+        std::string line;
+        while (std::getline(list, line))
+        {
+            // Skip blank lines and comments
+            auto first = line.find_first_not_of(" \t\r");
+            if (first == std::string::npos || line[first] == '#')
+            {
+                continue;
+            }
+            auto last = line.find_last_not_of(" \t\r");
+            filePaths.push_back(line.substr(first, last - first + 1));
+        }
+    }
+    if (filePaths.empty())
+    {
+        printError("Required argument \"d\" was not specified.");
+        throw SkipToNextUserInput();
+    }
+
+    return filePaths;
 }
 
-long GetFileSize(std::string filename)
+// Runs the transfers of one command, given on the command line, typed in or from a script
+int runCommand(const cxxopts::ParseResult &argumentsResult)
 {
-    struct stat stat_buf;
-    int rc = stat(filename.c_str(), &stat_buf);
-    return rc == 0 ? stat_buf.st_size : -1;
+    if (argumentsResult.count("h") != 0)
+    {
+        std::cout << setupArguments().help() << EXIT_STATUS_HELP;
+        return EXIT_OK;
+    }
+    setLogLevel(argumentsResult.count("v") != 0 ? LogLevel::Debug : LogLevel::Info);
+    std::vector<std::unique_ptr<Session>> sessions;
+    std::vector<std::string> filePaths;
+    if (argumentsResult.count("f") == 1)
+    {
+        if (argumentsResult.count("d") != 0 || argumentsResult.count("l") != 0)
+        {
+            printError("Do not combine a script with -d or -l.");
+            throw SkipToNextUserInput();
+        }
+        addScriptTransfers(argumentsResult["f"].as<std::string>(), sessions, filePaths);
+    }
+    else
+    {
+        addTransfers(argumentsResult, sessions, filePaths);
+    }
+    checkDistinctBaseNames(filePaths);
+    return transferFiles(argumentsResult, sessions, filePaths);
 }
 
-unsigned int stdStr2intHash(std::string str, int h)
+void addTransfers(const cxxopts::ParseResult &argumentsResult, std::vector<std::unique_ptr<Session>> &sessions, std::vector<std::string> &filePaths)
 {
-    return !str.c_str()[h] ? 5381 : (str2intHash(str.c_str(), h + 1) * 33) ^ str.c_str()[h];
+    for (auto &filePath : collectFilePaths(argumentsResult))
+    {
+        sessions.push_back(Session::create(makeTransferOptions(argumentsResult, filePath)));
+        filePaths.push_back(filePath);
+    }
 }
 
-bool checkOACKs(char *buffer, int recvBytesCount, UDP &connection, int timeoutOffer, int &timeout, int blocksizeOffer, int &blocksize, long unsigned int &transferSize, bool read)
+// Every line of the script is one command. All of them are checked before anything is transferred
+void addScriptTransfers(const std::string &scriptPath, std::vector<std::unique_ptr<Session>> &sessions, std::vector<std::string> &filePaths)
 {
-    if (buffer[0] == 0 && buffer[1] == 6) // 06 = OACK
+    std::ifstream script(scriptPath);
+    if (!script)
     {
-        int bufferPos = 2;
-        int thisOptionLength;
-        int thisValueLength;
-        int thisValuePos;
-        int nextOptionStartIndex;
-        do
+        printError("Cannot open script " + scriptPath + ".");
+        throw SkipToNextUserInput();
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(script, line))
+    {
+        lineNumber++;
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
         {
-            const char *optionName = buffer + bufferPos;
-            thisOptionLength = std::strlen(optionName);
-
-            thisValuePos = bufferPos + thisOptionLength + 1;
-            const char *optionValue = buffer + thisValuePos;
-            thisValueLength = std::strlen(optionValue);
-
-            nextOptionStartIndex = std::min(thisValuePos + thisValueLength + 1, DEFAULT_BLOCK_SIZE - 1);
-
-            auto optionValueString = std::string(optionValue);
-            std::istringstream optionValueStream(optionValueString);
-            switch (str2intHash(optionName))
+            continue;
+        }
+        std::string location = scriptPath + ":" + std::to_string(lineNumber) + ": ";
+        try
+        {
+            CustomArgLine separated = CustomArgLine(line);
+            auto lineResult = parseArguments(separated);
+            if (lineResult.count("f") != 0)
             {
-            case str2intHash("timeout"):
-                if (checkOptionError(timeoutOffer, optionValueString, optionName))
-                {
-                    timeout = timeoutOffer;
-                    printTimestamp();
-                    std::cout << "Timeout accepted" << std::endl;
-                }
-                else
-                {
-                    timeout = 0;
-                }
-                break;
-
-            case str2intHash("blksize"):
-                if (checkOptionError(blocksizeOffer, optionValueString, optionName))
-                {
-                    blocksize = blocksizeOffer;
-                    printTimestamp();
-                    std::cout << "Block size accepted" << std::endl;
-                }
-                else
-                {
-                    blocksize = DEFAULT_BLOCK_SIZE;
-                }
-                break;
-
-            case str2intHash("tsize"):
-                if (read)
-                {
-                    optionValueStream >> transferSize;
-                }
-                else
-                {
-                    if(!checkOptionError(transferSize, optionValueString, optionName))
-                    {
-                        throw SkipToNextUserInput();//Server will not accept the file of this size
-                    }
-                }
-                printTimestamp();
-                std::cout << "Transfered file size will be: " << transferSize << std::endl;
-                break;
-            case str2intHash("\n\b"):
-                printTimestamp();
-                std::cout << "End of option acknowledgements" << std::endl;
-                break;
-
-            default:
-                std::ostringstream errOutput;
-                errOutput << "Unknown option OACK: " << optionName;
-                printError(errOutput.str());
-                break;
+                printError(location + "A script cannot run another script.");
+                throw SkipToNextUserInput();
             }
-            //Advance to next option
-            bufferPos = nextOptionStartIndex;
-        } while (nextOptionStartIndex < recvBytesCount);
-        return true;
+            addTransfers(lineResult, sessions, filePaths);
+        }
+        catch (const std::exception &e)
+        {
+            printError(location + e.what());
+            throw SkipToNextUserInput();
+        }
+        catch (const SkipToNextUserInput &e)
+        {
+            printError(location + "Invalid command.");
+            throw;
+        }
     }
-    return false;
 }
 
-ServerConfig parseServerConfig(std::string confString)
+void checkDistinctBaseNames(const std::vector<std::string> &filePaths)
 {
-    ServerConfig result;
-    std::stringstream test(confString);
-    std::string segment;
-    std::vector<std::string> seglist;
-
-    if (std::getline(test, segment, ','))
+    // Sessions must not share a local file
+    std::vector<std::string> baseNames;
+    for (auto &filePath : filePaths)
     {
-        result.server = segment;
+        auto fileBaseName = base_name(filePath);
+        if (std::find(baseNames.begin(), baseNames.end(), fileBaseName) != baseNames.end())
+        {
+            printError("File " + fileBaseName + " was specified more than once.");
+            throw SkipToNextUserInput();
+        }
+        baseNames.push_back(fileBaseName);
     }
-    test >> result.port;
-
-    return result;
 }
 
-template <typename T, typename U, typename V>
-bool checkOptionError(T optionValue, U serverValue, V optionName)
+TransferOptions makeTransferOptions(const cxxopts::ParseResult &argumentsResult, const std::string &filePath)
 {
-    if (serverValue != std::to_string(optionValue))
+    TransferOptions options;
+    ServerConfig serverConfig = parseServerConfig(argumentsResult["a"].as<std::string>());
+    options.server = serverConfig.server;
+    options.port = serverConfig.port;
+    options.filePath = filePath;
+    options.mode = argumentsResult["c"].as<std::string>();
+    std::vector<std::string> permittedModes = {"ascii", "octet", "netascii", "binary"};
+    if (std::find(permittedModes.begin(), permittedModes.end(), options.mode) == permittedModes.end())
     {
-        std::ostringstream errOut("Server did not recognize ");
-        errOut << optionName << " (we sent " << optionValue << " and server replied " << serverValue << ")";
-        printError(errOut.str());
-        return false;
+        printError("Unknown transfer mode specified, but trying to use it...");
+    }
+
+    if (argumentsResult.count("R") == argumentsResult.count("W"))
+    {
+        printError(argumentsResult.count("R") ? "Do not combine Read and Write arguments." : "Specify either -R for Read or -W for Write file mode.");
+        throw SkipToNextUserInput();
     }
-    return true;
+    options.read = argumentsResult.count("R") == 1;
+    if (argumentsResult.count("s") == 1)
+    {
+        options.blockSizeOffer = argumentsResult["s"].as<int>();
+    }
+    options.timeoutOffer = argumentsResult["t"].as<int>();
+    options.windowSizeOffer = std::max(argumentsResult["w"].as<int>(), 1);
+    options.rollover = argumentsResult["r"].as<int>();
+    if (options.rollover != 0 && options.rollover != 1)
+    {
+        printError("Block numbers can roll over only to 0 or 1.");
+        throw SkipToNextUserInput();
+    }
+    options.multicast = argumentsResult.count("m") == 1;
+    options.background = argumentsResult.count("b") == 1;
+    options.coroutine = argumentsResult.count("coroutine") == 1;
+    return options;
 }
 
-void printTimestamp()
+int transferFiles(const cxxopts::ParseResult &argumentsResult, std::vector<std::unique_ptr<Session>> &sessions, const std::vector<std::string> &filePaths)
 {
-    //https://stackoverflow.com/questions/24686846/get-current-time-in-milliseconds-or-hhmmssmmm-format
-    // get current time
-    auto now = std::chrono::system_clock::now();
+    if (sessions.size() == 1)
+    {
+        // Messages of a single transfer are not prefixed
+        sessions[0]->name.clear();
+    }
+    int concurrency = std::max(argumentsResult["j"].as<int>(), 1);
+    if (sessions.size() > 1)
+    {
+        logInfo() << "Transferring " << sessions.size() << " files, at most " << concurrency << " at once";
+    }
 
-    // get number of milliseconds for the current second
-    // (remainder after division into seconds)
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
+    auto start = std::chrono::steady_clock::now();
+    int threads = argumentsResult["n"].as<int>();
+    if (sessions.size() == 1 || threads == 1)
+    {
+        // One thread waits for datagrams and timeouts of all sessions at once
+        EventLoop loop;
+        loop.run(sessions, concurrency);
+        if (sessions.size() == 1)
+        {
+            return exitStatus(sessions);
+        }
+    }
+    else
+    {
+        if (threads <= 0)
+        {
+            threads = std::thread::hardware_concurrency();
+        }
+        ShardedEngine engine(std::min<size_t>({static_cast<size_t>(std::max(threads, 1)), sessions.size(), static_cast<size_t>(concurrency)}));
+        engine.run(sessions, concurrency);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-    // convert to std::time_t in order to convert to std::tm (broken time)
-    auto time = std::chrono::system_clock::to_time_t(now);
-    auto local = *std::localtime(&time);
-    std::cout << '[' << std::put_time(&local, "%Y-%m-%d %H:%M:%S.") << std::setfill('0') << std::setw(3) << ms.count();
-    std::cout << "] ";
+    int succeeded = 0;
+    size_t bytes = 0;
+    for (auto &session : sessions)
+    {
+        succeeded += session->succeeded();
+        bytes += session->transferred;
+    }
+    logInfo() << "Transferred " << succeeded << " of " << sessions.size() << " files (" << bytes << " bytes) in " << std::fixed << std::setprecision(3) << seconds << " s";
+    flushLog();
+    std::cout << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < sessions.size(); i++)
+    {
+        auto &session = *sessions[i];
+        std::cout << (session.succeeded() ? "  OK     " : "  FAILED ") << filePaths[i] << " ";
+        if (session.succeeded())
+        {
+            std::cout << session.transferred << " bytes in " << std::chrono::duration<double>(session.finishedAt - session.startedAt).count() << " s" << std::endl;
+        }
+        else
+        {
+            std::cout << session.error << std::endl;
+        }
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+    return exitStatus(sessions);
 }
 
-void printError(std::string error)
+int exitStatus(const std::vector<std::unique_ptr<Session>> &sessions)
 {
-    printTimestamp();
-    std::cerr << error << std::endl;
+    for (auto &session : sessions)
+    {
+        if (!session->succeeded())
+        {
+            return EXIT_TRANSFER_FAILED + static_cast<int>(session->code);
+        }
+    }
+    return EXIT_OK;
 }
 
-template <typename T>
-T requiredArgumentGet(cxxopts::ParseResult argumentsResult, std::string argumentName)
+unsigned int stdStr2intHash(std::string str, int h)
 {
-    int count;
-    if ((count = argumentsResult.count(argumentName)) == 1)
-    {
-        return argumentsResult[argumentName].as<T>();
-    }
-    else
+    return !str.c_str()[h] ? 5381 : (str2intHash(str.c_str(), h + 1) * 33) ^ str.c_str()[h];
+}
+
+ServerConfig parseServerConfig(std::string confString)
+{
+    ServerConfig result;
+    std::stringstream test(confString);
+    std::string segment;
+    std::vector<std::string> seglist;
+
+    if (std::getline(test, segment, ','))
     {
-        std::stringstream out;
-        out << "Required argument \"" << argumentName << "\" was specified " << count << " times.";
-        printError(out.str());
-        throw SkipToNextUserInput();
+        result.server = segment;
     }
-}
\ No newline at end of file
+    test >> result.port;
+
+    return result;
+}
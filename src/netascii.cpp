@@ -0,0 +1,229 @@
+#include "netascii.hpp"
+#include <algorithm>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NETASCII_X86 1
+#endif
+
+size_t scanScalar(const char *data, size_t length);
+const NetasciiKernel &kernel();
+#ifdef NETASCII_X86
+size_t scanSSE2(const char *data, size_t length);
+size_t scanAVX2(const char *data, size_t length);
+size_t scanAVX512(const char *data, size_t length);
+#endif
+
+size_t scanScalar(const char *data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        if (data[i] == '\r' || data[i] == '\n' || data[i] == '\0')
+        {
+            return i;
+        }
+    }
+    return length;
+}
+
+#ifdef NETASCII_X86
+// Each kernel compares a whole vector with the three bytes at once and finds the first match in the bit mask.
+// The tail shorter than one vector goes to the narrower kernel
+
+__attribute__((target("sse2"))) size_t scanSSE2(const char *data, size_t length)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        __m128i matches = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, cr), _mm_cmpeq_epi8(bytes, lf)), _mm_cmpeq_epi8(bytes, zero));
+        unsigned mask = _mm_movemask_epi8(matches);
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + scanScalar(data + i, length - i);
+}
+
+__attribute__((target("avx2"))) size_t scanAVX2(const char *data, size_t length)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        __m256i matches = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, cr), _mm256_cmpeq_epi8(bytes, lf)), _mm256_cmpeq_epi8(bytes, zero));
+        unsigned mask = _mm256_movemask_epi8(matches);
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + scanSSE2(data + i, length - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) size_t scanAVX512(const char *data, size_t length)
+{
+    const __m512i cr = _mm512_set1_epi8('\r');
+    const __m512i lf = _mm512_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 64 <= length; i += 64)
+    {
+        __m512i bytes = _mm512_loadu_si512(data + i);
+        __mmask64 mask = _mm512_cmpeq_epi8_mask(bytes, cr) | _mm512_cmpeq_epi8_mask(bytes, lf) | _mm512_testn_epi8_mask(bytes, bytes);
+        if (mask != 0)
+        {
+            return i + __builtin_ctzll(mask);
+        }
+    }
+    return i + scanAVX2(data + i, length - i);
+}
+#endif
+
+std::vector<NetasciiKernel> supportedNetasciiKernels()
+{
+    std::vector<NetasciiKernel> kernels;
+#ifdef NETASCII_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw"))
+    {
+        kernels.push_back({scanAVX512, "avx512"});
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernels.push_back({scanAVX2, "avx2"});
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        kernels.push_back({scanSSE2, "sse2"});
+    }
+#endif
+    kernels.push_back({scanScalar, "scalar"});
+    return kernels;
+}
+
+const NetasciiKernel &kernel()
+{
+    static const NetasciiKernel selected = supportedNetasciiKernels().front();
+    return selected;
+}
+
+size_t scanNetascii(const char *data, size_t length)
+{
+    return kernel().scan(data, length);
+}
+
+const char *netasciiKernel()
+{
+    return kernel().name;
+}
+
+std::span<char> NetasciiDecoder::decode(char *data, size_t length, bool last)
+{
+    char *start = data; // Output is compacted towards here
+    size_t in = 0;
+    size_t out = 0;
+    if (pendingCR && (length != 0 || last))
+    {
+        pendingCR = false;
+        if (length != 0 && data[0] == '\n')
+        {
+            in = out = 1;
+        }
+        else if (length != 0 && data[0] == '\0')
+        {
+            data[0] = '\r';
+            in = out = 1;
+        }
+        else
+        {
+            start = data - 1;
+            *start = '\r';
+            out = 1;
+        }
+    }
+    while (in < length)
+    {
+        size_t plain = scanNetascii(data + in, length - in);
+        if (start + out != data + in)
+        {
+            memmove(start + out, data + in, plain);
+        }
+        in += plain;
+        out += plain;
+        if (in == length)
+        {
+            break;
+        }
+        char special = data[in++];
+        if (special != '\r')
+        {
+            start[out++] = special; // LF or NUL on its own stays as it is
+            continue;
+        }
+        if (in == length && !last)
+        {
+            pendingCR = true;
+            break;
+        }
+        if (in < length && data[in] == '\n')
+        {
+            start[out++] = '\n';
+            in++;
+        }
+        else
+        {
+            // CR NUL, or a CR on its own
+            start[out++] = '\r';
+            in += in < length && data[in] == '\0';
+        }
+    }
+    return {start, out};
+}
+
+size_t NetasciiEncoder::encode(const char *input, size_t length, char *output, size_t capacity, size_t &consumed)
+{
+    size_t in = 0;
+    size_t out = 0;
+    if (carrying && capacity != 0)
+    {
+        output[out++] = carried;
+        carrying = false;
+    }
+    while (in < length && out < capacity)
+    {
+        size_t plain = scanNetascii(input + in, std::min(length - in, capacity - out));
+        memcpy(output + out, input + in, plain);
+        in += plain;
+        out += plain;
+        if (in == length || out == capacity)
+        {
+            break;
+        }
+        char special = input[in++];
+        if (special == '\0')
+        {
+            output[out++] = '\0';
+            continue;
+        }
+        output[out++] = '\r';
+        char second = special == '\n' ? '\n' : '\0';
+        if (out < capacity)
+        {
+            output[out++] = second;
+        }
+        else
+        {
+            carried = second;
+            carrying = true;
+        }
+    }
+    consumed = in;
+    return out;
+}
@@ -0,0 +1,85 @@
+#include "packet.hpp"
+#include <cstring>
+
+OptionIterator::OptionIterator(const char *position, const char *end) : position(position), end(end)
+{
+    read();
+}
+
+void OptionIterator::read()
+{
+    const char *nameEnd = position == end ? nullptr : static_cast<const char *>(memchr(position, '\0', end - position));
+    const char *valueEnd = nameEnd == nullptr ? nullptr : static_cast<const char *>(memchr(nameEnd + 1, '\0', end - nameEnd - 1));
+    if (valueEnd == nullptr)
+    {
+        position = end;
+        return;
+    }
+    option.name = std::string_view(position, nameEnd - position);
+    option.value = std::string_view(nameEnd + 1, valueEnd - nameEnd - 1);
+}
+
+OptionIterator &OptionIterator::operator++()
+{
+    position = option.value.data() + option.value.length() + 1;
+    read();
+    return *this;
+}
+
+PacketView::PacketView(const char *header, int length, const char *body) : header(header), body(body), length(length)
+{
+    if (length < 2 || header[0] != 0)
+    {
+        return;
+    }
+    auto opcode = static_cast<Opcode>(header[1]);
+    switch (opcode)
+    {
+    case Opcode::DATA:
+    case Opcode::ACK:
+    case Opcode::ERROR:
+        if (length >= 4)
+        {
+            type = opcode;
+        }
+        break;
+
+    case Opcode::RRQ:
+    case Opcode::WRQ:
+    {
+        // File name and mode are zero-terminated, options follow
+        const char *end = header + length;
+        const char *nameEnd = static_cast<const char *>(memchr(header + 2, '\0', end - header - 2));
+        const char *modeEnd = nameEnd == nullptr ? nullptr : static_cast<const char *>(memchr(nameEnd + 1, '\0', end - nameEnd - 1));
+        if (modeEnd != nullptr)
+        {
+            type = opcode;
+            optionsOffset = modeEnd + 1 - header;
+        }
+        break;
+    }
+
+    case Opcode::OACK:
+        type = opcode;
+        optionsOffset = 2;
+        break;
+
+    default:
+        break;
+    }
+}
+
+std::string_view PacketView::errorMessage() const
+{
+    return std::string_view(body, strnlen(body, length - 4));
+}
+
+OptionRange PacketView::options() const
+{
+    const char *end = header + length;
+    if (body != header + 4)
+    {
+        end = header + optionsOffset; // Options are not all in the header, so none is read
+    }
+    return {OptionIterator(header + optionsOffset, end), OptionIterator(end, end)};
+}
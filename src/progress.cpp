@@ -0,0 +1,57 @@
+#include "progress.hpp"
+#include "log.hpp"
+#include <iomanip>
+
+using namespace std::chrono_literals;
+
+#define PROGRESS_INTERVAL 250ms // Shortest time between two reports
+#define MEBIBYTE (1024.0 * 1024.0)
+
+void ProgressReporter::start()
+{
+    started = std::chrono::steady_clock::now();
+    lastReport = started;
+    lastBytes = 0;
+}
+
+void ProgressReporter::update(size_t bytes, size_t total)
+{
+    if (!logEnabled(LogLevel::Info))
+    {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastReport < PROGRESS_INTERVAL)
+    {
+        return;
+    }
+    report(now, bytes, total);
+}
+
+void ProgressReporter::report(std::chrono::steady_clock::time_point now, size_t bytes, size_t total)
+{
+    double sinceLast = std::chrono::duration<double>(now - lastReport).count();
+    double sinceStart = std::chrono::duration<double>(now - started).count();
+    double current = (bytes - lastBytes) / sinceLast;
+    double average = bytes / sinceStart;
+
+    LogLine line(LogLevel::Info);
+    line << std::fixed << std::setprecision(1) << "Progress: " << bytes / MEBIBYTE;
+    // Netascii data may grow while encoded, so the total is only an estimate
+    if (total != 0 && bytes <= total)
+    {
+        line << " of " << total / MEBIBYTE << " MiB (" << static_cast<int>(100.0 * bytes / total) << "%)";
+    }
+    else
+    {
+        line << " MiB";
+    }
+    line << ", " << current / MEBIBYTE << " MiB/s now, " << average / MEBIBYTE << " MiB/s average";
+    if (total != 0 && bytes <= total && average > 0)
+    {
+        line << ", " << (total - bytes) / average << " s left";
+    }
+
+    lastReport = now;
+    lastBytes = bytes;
+}
@@ -0,0 +1,72 @@
+#include "rtt.hpp"
+#include <algorithm>
+
+using namespace std::chrono_literals;
+
+#define INITIAL_RTO 1s
+#define MIN_RTO 2ms
+#define MAX_RTO 16s
+#define GIVE_UP_AFTER 30s
+
+RttEstimator::RttEstimator() : base(INITIAL_RTO), minimum(MIN_RTO), maximum(MAX_RTO), giveUpAfter(GIVE_UP_AFTER)
+{
+}
+
+void RttEstimator::sample(std::chrono::microseconds rtt)
+{
+    if (!measured)
+    {
+        smoothed = rtt;
+        variance = rtt / 2;
+        measured = true;
+    }
+    else
+    {
+        auto difference = smoothed > rtt ? smoothed - rtt : rtt - smoothed;
+        variance = (variance * 3 + difference) / 4;
+        smoothed = (smoothed * 7 + rtt) / 8;
+    }
+    base = smoothed + variance * 4;
+}
+
+void RttEstimator::sent(bool retransmission)
+{
+    if (retransmission)
+    {
+        ambiguous = true;
+        retransmissions++;
+    }
+    else if (!pending)
+    {
+        sentAt = std::chrono::steady_clock::now();
+        pending = true;
+    }
+}
+
+void RttEstimator::answered()
+{
+    if (pending && !ambiguous)
+    {
+        sample(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sentAt));
+    }
+    pending = false;
+    ambiguous = false;
+    backoffShift = 0;
+    waited = 0us;
+}
+
+bool RttEstimator::backoff()
+{
+    timeouts++;
+    waited += timeout();
+    if (timeout() < maximum)
+    {
+        backoffShift++;
+    }
+    return giveUpAfter.count() == 0 || waited < giveUpAfter;
+}
+
+std::chrono::microseconds RttEstimator::timeout() const
+{
+    return std::clamp(base * (1 << backoffShift), minimum, maximum);
+}
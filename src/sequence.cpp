@@ -0,0 +1,48 @@
+#include "sequence.hpp"
+#include <algorithm>
+#include <bit>
+
+SequenceTracker::SequenceTracker(uint64_t window, uint64_t first) : words((std::max<uint64_t>(window, 1) + 63) / 64, 0), window(std::max<uint64_t>(window, 1)), missing(first)
+{
+}
+
+SequenceTracker::Arrival SequenceTracker::classify(uint64_t block) const
+{
+    if (block < missing)
+    {
+        return Arrival::Duplicate;
+    }
+    if (block - missing >= window)
+    {
+        return Arrival::Ahead;
+    }
+    return test(block) ? Arrival::Duplicate : Arrival::New;
+}
+
+SequenceTracker::Arrival SequenceTracker::receive(uint64_t block)
+{
+    auto arrival = classify(block);
+    if (arrival != Arrival::New)
+    {
+        return arrival;
+    }
+    words[block / 64 % words.size()] |= uint64_t(1) << (block % 64);
+    // Bits of the blocks passed are cleared, so they can stand for blocks one ring further
+    while (true)
+    {
+        uint64_t &word = words[missing / 64 % words.size()];
+        int offset = missing % 64;
+        int run = std::countr_one(word >> offset);
+        if (run == 0)
+        {
+            break;
+        }
+        word &= ~((run == 64 ? ~uint64_t(0) : (uint64_t(1) << run) - 1) << offset);
+        missing += run;
+        if (offset + run < 64)
+        {
+            break;
+        }
+    }
+    return arrival;
+}
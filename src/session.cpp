@@ -0,0 +1,878 @@
+#include "session.hpp"
+#include "cosession.hpp"
+#include "eventloop.hpp"
+#include "log.hpp"
+#include "strhash.hpp"
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <sys/vfs.h>
+
+#define RECEIVE_BATCH_SIZE 64
+#define WRITER_QUEUE_BLOCKS 256
+#define MULTICAST_TRACKED_BLOCKS 65536 // Without tsize
+#define GIVE_UP_TIMEOUTS 5              // Times the -t timeout without an answer before a transfer fails
+
+template <typename T>
+bool checkOptionError(T optionValue, std::string_view serverValue, std::string_view optionName);
+
+std::string base_name(std::string const &path)
+{
+    //https://stackoverflow.com/questions/8520560/get-a-file-name-from-a-path
+    return path.substr(path.find_last_of("/\\") + 1);
+}
+
+void throwServerError(const PacketView &packet)
+{
+    std::ostringstream errOutput;
+    errOutput << "Server send an error packet. Contents:" << std::endl;
+    errOutput << packet.errorMessage();
+    throw TransferException(TransferError::ServerError, errOutput.str(), packet.errorCode());
+}
+
+template <typename T>
+bool checkOptionError(T optionValue, std::string_view serverValue, std::string_view optionName)
+{
+    T serverNumber;
+    if (!parseNumber(serverValue, serverNumber) || serverNumber != optionValue)
+    {
+        std::ostringstream errOut;
+        errOut << "Server did not recognize " << optionName << " (we sent " << optionValue << " and server replied " << serverValue << ")";
+        printError(errOut.str());
+        return false;
+    }
+    return true;
+}
+
+Session::Session(TransferOptions options) : options(options), blockSizeOffer(options.blockSizeOffer), name(base_name(options.filePath))
+{
+    tftp.setRollover(options.rollover);
+    // No timeout was asked for, so a silent server is retried forever
+    tftp.roundTrip().giveUpAfter = GIVE_UP_TIMEOUTS * std::chrono::seconds(options.timeoutOffer);
+}
+
+std::unique_ptr<Session> Session::create(TransferOptions options)
+{
+    if (options.read && options.coroutine)
+    {
+        return std::make_unique<CoroutineReadSession>(options);
+    }
+    if (options.read)
+    {
+        return std::make_unique<ReadSession>(options);
+    }
+    return std::make_unique<WriteSession>(options);
+}
+
+void Session::connect()
+{
+    logInfo() << "Creating connection to server " << options.server << " port " << options.port;
+    connection.createSocket(options.server, options.port);
+    connection.setNonBlocking();
+    loop->watch(*this, connection);
+    progress.start();
+
+    if (blockSizeOffer > DEFAULT_BLOCK_SIZE)
+    {
+        int minimalMTU = connection.getMinimalMTU();
+        blockSizeOffer = std::min(blockSizeOffer, minimalMTU);
+        logInfo() << "Minimal MTU of all network interfaces is " << minimalMTU << ". Blocksize set to " << blockSizeOffer;
+    }
+}
+
+void Session::rearm()
+{
+    loop->schedule(*this, tftp.retransmitTimeout());
+}
+
+void Session::complete(size_t bytes)
+{
+    transferred = bytes;
+    done = true;
+    logInfo() << "Connection finished.";
+}
+
+void Session::fail(std::string message, TransferError code, int serverCode)
+{
+    printError(message);
+    error = message;
+    this->code = code;
+    this->serverCode = serverCode;
+    done = true;
+}
+
+void Session::fail(const std::exception &exception)
+{
+    if (auto transferException = dynamic_cast<const TransferException *>(&exception))
+    {
+        fail(exception.what(), transferException->code, transferException->serverCode);
+    }
+    else if (dynamic_cast<const TimeoutException *>(&exception))
+    {
+        fail(exception.what(), TransferError::Timeout);
+    }
+    else if (dynamic_cast<const UDPException *>(&exception))
+    {
+        fail(exception.what(), TransferError::Network);
+    }
+    else
+    {
+        fail(exception.what());
+    }
+}
+
+void Session::release()
+{
+    stats.datagramsSent += connection.datagramsSent;
+    stats.datagramsReceived += connection.datagramsReceived;
+    stats.retransmissions = tftp.roundTrip().retransmissions;
+    stats.timeouts = tftp.roundTrip().timeouts;
+    stats.blocksize = blocksize;
+    stats.windowsize = windowsize;
+    connection.close();
+}
+
+TransferResult Session::result() const
+{
+    TransferResult result;
+    result.succeeded = succeeded();
+    result.bytes = transferred;
+    result.code = code;
+    result.serverCode = serverCode;
+    result.error = error;
+    result.stats = stats;
+    result.stats.seconds = std::chrono::duration<double>(finishedAt - startedAt).count();
+    return result;
+}
+
+bool Session::applyOACK(const PacketView &packet)
+{
+    if (!packet.is(Opcode::OACK))
+    {
+        return false;
+    }
+    for (auto &option : packet.options())
+    {
+        // Option names are zero-terminated in the packet
+        switch (str2intHash(option.name.data()))
+        {
+        case str2intHash("timeout"):
+            if (checkOptionError(options.timeoutOffer, option.value, option.name))
+            {
+                tftp.setTimeout(options.timeoutOffer);
+                logInfo() << "Timeout accepted";
+            }
+            else
+            {
+                tftp.setTimeout(0);
+            }
+            break;
+
+        case str2intHash("blksize"):
+            if (checkOptionError(blockSizeOffer, option.value, option.name))
+            {
+                blocksize = blockSizeOffer;
+                logInfo() << "Block size accepted";
+            }
+            else
+            {
+                blocksize = DEFAULT_BLOCK_SIZE;
+            }
+            break;
+
+        case str2intHash("windowsize"):
+            // RFC 7440 allows the server to reply with a smaller window than offered
+            if (!parseNumber(option.value, windowsize) || windowsize < 1 || windowsize > options.windowSizeOffer)
+            {
+                checkOptionError(options.windowSizeOffer, option.value, option.name);
+                windowsize = 1;
+            }
+            else
+            {
+                logInfo() << "Window size " << windowsize << " accepted";
+            }
+            break;
+
+        case str2intHash("multicast"):
+        {
+            // Value is "address,port,mc". Address and port may be empty in OACKs
+            // which only change the master client
+            auto value = option.value;
+            auto addressEnd = std::min(value.find(','), value.length());
+            auto address = value.substr(0, addressEnd);
+            value.remove_prefix(std::min(addressEnd + 1, value.length()));
+            auto portEnd = std::min(value.find(','), value.length());
+            auto port = value.substr(0, portEnd);
+            auto master = value.substr(std::min(portEnd + 1, value.length()));
+            if (!address.empty())
+            {
+                multicast.address = address;
+            }
+            if (!port.empty() && !parseNumber(port, multicast.port))
+            {
+                throw TransferException(TransferError::Protocol, "Server announced an invalid multicast port.");
+            }
+            multicast.master = master == "1";
+            multicast.enabled = options.read && !multicast.address.empty() && multicast.port != 0;
+            logInfo() << "Multicast group " << multicast.address << " port " << multicast.port << (multicast.master ? " as master client" : "");
+            break;
+        }
+
+        case str2intHash("rollover"):
+        {
+            int rollover = -1;
+            if (!parseNumber(option.value, rollover) || (rollover != 0 && rollover != 1))
+            {
+                checkOptionError(options.rollover, option.value, option.name);
+                break;
+            }
+            tftp.setRollover(rollover);
+            logInfo() << "Block numbers roll over to " << rollover;
+            break;
+        }
+
+        case str2intHash("tsize"):
+            if (options.read)
+            {
+                parseNumber(option.value, transferSize);
+            }
+            else
+            {
+                if (!checkOptionError(transferSize, option.value, option.name))
+                {
+                    throw TransferException(TransferError::Protocol, "Server will not accept the file of this size.");
+                }
+            }
+            logInfo() << "Transfered file size will be: " << transferSize;
+            break;
+
+        default:
+            std::ostringstream errOutput;
+            errOutput << "Unknown option OACK: " << option.name;
+            printError(errOutput.str());
+            break;
+        }
+    }
+    return true;
+}
+
+void ReadSession::start(EventLoop &loop)
+{
+    this->loop = &loop;
+    connect();
+
+    sink = options.sink;
+    if (sink == nullptr)
+    {
+        struct statfs64 fileSystemInfo;
+        auto fileBaseName = base_name(options.filePath);
+        ownedSink = std::make_unique<MappedFileSink>(fileBaseName);
+        sink = ownedSink.get();
+        statfs64(fileBaseName.c_str(), &fileSystemInfo);//Get free disk space
+        logInfo() << "There are " << fileSystemInfo.f_bsize * fileSystemInfo.f_bfree << " free bytes on disk";
+    }
+
+    if (options.multicast && (options.mode == "ascii" || options.mode == "netascii"))
+    {
+        // Blocks are written at offsets computed from their numbers, which netascii conversion breaks
+        printError("Multicast is supported only in binary mode. Requesting unicast transfer.");
+        options.multicast = false;
+    }
+
+    logInfo() << "Sending read file request with " << options.mode << " mode";
+    tftp.sendRRQ(connection, options.filePath, options.mode, blockSizeOffer, options.timeoutOffer, options.windowSizeOffer, options.multicast);
+    tftp.roundTrip().sent();
+    rearm();
+
+    // All datagrams already waiting in the socket are taken at once, at most one window of them
+    batch = std::make_unique<DatagramBatch>(std::min(options.windowSizeOffer, RECEIVE_BATCH_SIZE), std::max(blockSizeOffer, blocksize) + 4); //+4 because 2 bytes for opcode and 2 bytes for the block number
+    acks = std::make_unique<OutgoingBatch>(batch->capacity()); // ACKs for the whole batch are sent together
+    writerBuffers.assign(batch->capacity(), nullptr);
+}
+
+bool ReadSession::targetBatch()
+{
+    if (tftp.netascii())
+    {
+        // Decoded blocks are shorter than received ones, so they cannot land in their place in the file
+        return true;
+    }
+    if (receiveToFile && options.background && !writer)
+    {
+        writer = std::make_unique<BackgroundWriter>(*sink, std::max(WRITER_QUEUE_BLOCKS, batch->capacity() * 2), blocksize);
+        loop->watchSignal(*this, writer->freedDescriptor());
+    }
+    if (writer)
+    {
+        for (int i = 0; i < batch->capacity(); i++)
+        {
+            if (writerBuffers[i] == nullptr && (writerBuffers[i] = writer->tryAcquire()) == nullptr)
+            {
+                return false; // The disk is behind
+            }
+            batch->target(i, writerBuffers[i], blocksize);
+        }
+    }
+    else if (receiveToFile)
+    {
+        // Each slot of the batch gets the place of one of the next expected blocks. The file is not
+        // mapped past tsize, slots of blocks which would not fit into it receive into the batch
+        size_t end = written + static_cast<size_t>(batch->capacity()) * blocksize;
+        if (transferSize != 0)
+        {
+            end = std::min(end, static_cast<size_t>(transferSize));
+        }
+        char *place = end > written ? sink->map(written, end) : nullptr;
+        for (int i = 0; i < batch->capacity(); i++)
+        {
+            size_t offset = static_cast<size_t>(i) * blocksize;
+            if (place != nullptr && written + offset + blocksize <= end)
+            {
+                batch->target(i, place + offset, blocksize);
+            }
+            else
+            {
+                batch->untarget(i);
+            }
+        }
+    }
+    return true;
+}
+
+void ReadSession::waitForWriter()
+{
+    // Waiting here would stall every session of the loop. Datagrams wait in the socket instead
+    // and the server slows down, as it does not get ACKs. The writer signals when it returns a buffer
+    starved = true;
+    loop->listen(connection, false);
+}
+
+void ReadSession::signalled()
+{
+    // Signals may come late, after the buffers were already taken
+    if (!starved || !targetBatch())
+    {
+        return;
+    }
+    starved = false;
+    loop->listen(connection, true);
+    rearm();
+}
+
+void ReadSession::readable(UDP &socket)
+{
+    if (multicast.enabled)
+    {
+        receiveMulticast(socket);
+        return;
+    }
+
+    if (!targetBatch())
+    {
+        waitForWriter();
+        return;
+    }
+    if (connection.receiveAvailable(*batch) == 0)
+    {
+        return;
+    }
+    bool finished = false;
+    for (int i = 0; i < batch->count && !finished && !multicast.enabled; i++)
+    {
+        finished = receiveDatagram(i);
+    }
+    if (acks->count != 0)
+    {
+        tftp.roundTrip().sent();
+        connection.sendBatch(*acks);
+    }
+    if (finished)
+    {
+        finishReading(written);
+    }
+    else
+    {
+        progress.update(written, transferSize);
+        rearm();
+    }
+}
+
+bool ReadSession::receiveDatagram(int index)
+{
+    PacketView packet(batch->datagram(index), batch->length(index), batch->payload(index));
+
+    if (batch->targeted(index))
+    {
+        if (packet.is(Opcode::OACK) && sequence.lastInOrder() == 0)
+        {
+            // Server repeats the OACK, because our ACK was lost
+            tftp.queueACK(*acks, 0);
+            return false;
+        }
+    }
+    // Receive option acknowledgements (OACKs)
+    // This function also updates corresponding option values
+    else if (applyOACK(packet))
+    {
+        //If received an OACK, server accepted the offer
+        //Continue with receiving
+        tftp.roundTrip().answered();
+        if (multicast.enabled)
+        {
+            // Blocks come from the multicast group from now on
+            joinGroup();
+            return false;
+        }
+        if (transferSize != 0 && !sink->preallocate(transferSize))
+        {
+            // Fail before the transfer starts, not in the middle of it
+            tftp.sendERROR(connection, 3, "Disk full or allocation exceeded");
+            throw TransferException(TransferError::DiskFull, "Not enough free space on disk for " + std::to_string(transferSize) + " bytes.");
+        }
+        logInfo() << "Sending ACK to OACK";
+        tftp.queueACK(*acks, 0);
+        receiveToFile = true;
+        return false;
+    }
+
+    //Check for error packet
+    if (packet.is(Opcode::ERROR))
+    {
+        throwServerError(packet);
+    }
+    else if (!packet.is(Opcode::DATA))
+    {
+        printError("Warning: Received packet which supposet to be DATA packet with unusual opcode");
+        return false;
+    }
+
+    uint64_t blockNumber = tftp.blockNumber(packet.blockNumber(), sequence.lastInOrder());
+    logEvent(LogLevel::Debug, LogEvent::BlockReceived, packet.size(), blockNumber);
+
+    auto arrival = sequence.receive(blockNumber);
+    if (arrival == SequenceTracker::Arrival::New)
+    {
+        bool finished = packet.size() < blocksize + 4;
+        // WRITE to the file, in the transfer mode. Nothing is copied when the block
+        // landed in its own slot
+        auto fileBytes = tftp.decodePayload(batch->payload(index), batch->payloadLength(index), finished);
+        if (writer && batch->targeted(index))
+        {
+            writer->push(writerBuffers[index], written, fileBytes.size());
+            writerBuffers[index] = nullptr;
+        }
+        else
+        {
+            sink->write(written, fileBytes.data(), fileBytes.size());
+        }
+        written += fileBytes.size();
+        outOfOrderCount = 0;
+        tftp.roundTrip().answered();
+        receiveToFile = true;
+
+        // Acknowledge only the whole window or the last block
+        if (finished || blockNumber - lastAckedBlock >= static_cast<uint64_t>(windowsize))
+        {
+            tftp.queueACK(*acks, blockNumber);
+            logEvent(LogLevel::Debug, LogEvent::AckSent, blockNumber);
+            lastAckedBlock = blockNumber;
+        }
+        return finished;
+    }
+
+    // Either a retransmitted block (our ACK was lost) or a gap in the window.
+    // Both are answered with ACK of the last block received in order, so the server
+    // continues from there. Only once per window, otherwise the server would restart
+    // the window for each of the remaining packets.
+    if (outOfOrderCount++ % windowsize == 0)
+    {
+        if (arrival == SequenceTracker::Arrival::Ahead)
+        {
+            printError("Expected " + std::to_string(sequence.firstMissing()) + " but got " + std::to_string(blockNumber));
+            printError("Block number out of sync.");
+        }
+        logEvent(LogLevel::Debug, LogEvent::AckResent, sequence.lastInOrder());
+        tftp.queueACK(*acks, sequence.lastInOrder());
+        tftp.roundTrip().sent(true);
+        lastAckedBlock = sequence.lastInOrder();
+    }
+    return false;
+}
+
+void ReadSession::expired()
+{
+    if (starved)
+    {
+        // Waiting for the disk uses up the same budget as waiting for a silent server
+        if (!targetBatch())
+        {
+            if (!tftp.roundTrip().backoff())
+            {
+                throw TransferException(TransferError::LocalFile, "Writing the file did not keep up with the transfer");
+            }
+            rearm();
+            return;
+        }
+        starved = false;
+        loop->listen(connection, true);
+        rearm();
+        return;
+    }
+    if (!tftp.roundTrip().backoff())
+    {
+        throw TimeoutException();
+    }
+    if (multicast.enabled)
+    {
+        if (multicast.master)
+        {
+            // Our last ACK was probably lost
+            sendACK(received.lastInOrder());
+            tftp.roundTrip().sent(true);
+        }
+        rearm();
+        return;
+    }
+    if (!receiveToFile)
+    {
+        // Neither OACK nor the first block came, the request was probably lost
+        logInfo() << "Timeout. Sending read file request again.";
+        tftp.sendRRQ(connection, options.filePath, options.mode, blockSizeOffer, options.timeoutOffer, options.windowSizeOffer, options.multicast);
+    }
+    else
+    {
+        // Our last ACK was probably lost
+        logInfo() << "Timeout. Sending ACK for " << sequence.lastInOrder() << " again.";
+        tftp.queueACK(*acks, sequence.lastInOrder());
+        connection.sendBatch(*acks);
+    }
+    tftp.roundTrip().sent(true);
+    rearm();
+}
+
+void ReadSession::sendACK(uint64_t blockNumber)
+{
+    tftp.sendACK(connection, blockNumber);
+}
+
+void ReadSession::joinGroup()
+{
+    if (transferSize != 0 && !sink->preallocate(transferSize))
+    {
+        tftp.sendERROR(connection, 3, "Disk full or allocation exceeded");
+        throw TransferException(TransferError::DiskFull, "Not enough free space on disk for " + std::to_string(transferSize) + " bytes.");
+    }
+    group = std::make_unique<UDP>();
+    group->createMulticastSocket(multicast.address, multicast.port);
+    group->setNonBlocking();
+    loop->watch(*this, *group);
+    logInfo() << "Joined multicast group " << multicast.address << " port " << multicast.port;
+
+    // Blocks may come from anywhere in the file, so the whole file is tracked when its size is known
+    received = SequenceTracker(transferSize != 0 ? transferSize / blocksize + 1 : MULTICAST_TRACKED_BLOCKS);
+    lastBlock = transferSize != 0 ? transferSize / blocksize + 1 : -1;
+    batch = std::make_unique<DatagramBatch>(RECEIVE_BATCH_SIZE, std::max(blocksize + 4, MAX_BUFFER));
+
+    if (multicast.master)
+    {
+        logInfo() << "Sending ACK to OACK";
+        sendACK(0);
+        tftp.roundTrip().sent();
+    }
+    rearm();
+}
+
+void ReadSession::receiveMulticast(UDP &socket)
+{
+    if (socket.receiveAvailable(*batch) == 0)
+    {
+        return;
+    }
+    for (int i = 0; i < batch->count; i++)
+    {
+        PacketView packet(batch->datagram(i), batch->length(i));
+        if (packet.is(Opcode::ERROR))
+        {
+            throwServerError(packet);
+        }
+        if (applyOACK(packet))
+        {
+            // Server changed the master client. The new master asks for the first block it misses
+            if (multicast.master)
+            {
+                logInfo() << "Became master client. Requesting block " << received.firstMissing();
+                sendACK(received.lastInOrder());
+            }
+            continue;
+        }
+        if (!packet.is(Opcode::DATA))
+        {
+            printError("Warning: Received packet which supposet to be DATA packet with unusual opcode");
+            continue;
+        }
+
+        // Blocks of the group come near the first missing one, so its round of 65536 blocks is taken
+        long blockNumber = tftp.blockNumber(packet.blockNumber(), received.firstMissing());
+        logEvent(LogLevel::Debug, LogEvent::BlockReceived, packet.size(), blockNumber);
+        if (blockNumber == 0)
+        {
+            continue;
+        }
+        long previousFirstMissing = received.firstMissing();
+        if (received.receive(blockNumber) == SequenceTracker::Arrival::New)
+        {
+            sink->write(static_cast<size_t>(blockNumber - 1) * blocksize, packet.payload().data(), packet.payload().size());
+            tftp.roundTrip().answered();
+            if (packet.size() < blocksize + 4)
+            {
+                lastBlock = blockNumber;
+                fileLength = static_cast<size_t>(blockNumber - 1) * blocksize + packet.payload().size();
+            }
+        }
+
+        // Master acknowledges progress, or the block before a gap, so the server sends the missing one.
+        // Blocks ahead of the tracked window are dropped and asked for again later
+        long firstMissing = received.firstMissing();
+        if (multicast.master && (firstMissing != previousFirstMissing || blockNumber > firstMissing))
+        {
+            sendACK(received.lastInOrder());
+            tftp.roundTrip().sent();
+        }
+    }
+
+    if (lastBlock != -1 && received.lastInOrder() >= static_cast<uint64_t>(lastBlock))
+    {
+        if (!multicast.master)
+        {
+            // Let the server know this client has the whole file
+            sendACK(lastBlock);
+        }
+        logInfo() << "Received all " << lastBlock << " blocks from multicast group";
+        finishReading(fileLength);
+        return;
+    }
+    progress.update(received.lastInOrder() * blocksize, transferSize);
+    rearm();
+}
+
+void ReadSession::finishReading(size_t length)
+{
+    if (writer)
+    {
+        writer->finish();
+    }
+    sink->close(length);
+    complete(length);
+}
+
+void ReadSession::release()
+{
+    writer.reset(); // Stops the writer thread of a failed transfer
+    ownedSink.reset();
+    sink = nullptr;
+    batch.reset();
+    acks.reset();
+    if (group)
+    {
+        stats.datagramsReceived += group->datagramsReceived;
+        group.reset();
+    }
+    received = SequenceTracker();
+    Session::release();
+}
+
+void WriteSession::start(EventLoop &loop)
+{
+    this->loop = &loop;
+    source = options.source;
+    if (source == nullptr)
+    {
+        ownedSource = std::make_unique<FileSource>(base_name(options.filePath));
+        source = ownedSource.get();
+    }
+    transferSize = source->size();
+    connect();
+
+    logInfo() << "Sending write file request with " << options.mode << " mode for " << transferSize << " bytes";
+    tftp.sendWRQ(connection, options.filePath, options.mode, blockSizeOffer, transferSize, options.timeoutOffer, options.windowSizeOffer);
+    tftp.roundTrip().sent();
+    rearm();
+    replies = std::make_unique<DatagramBatch>(RECEIVE_BATCH_SIZE, MAX_BUFFER);
+}
+
+void WriteSession::readable(UDP &socket)
+{
+    if (connection.receiveAvailable(*replies) == 0)
+    {
+        return;
+    }
+    for (int i = 0; i < replies->count; i++)
+    {
+        PacketView packet(replies->datagram(i), replies->length(i));
+        if (requesting)
+        {
+            acceptReply(packet);
+        }
+        else
+        {
+            acceptACK(packet);
+        }
+    }
+    if (lastBlock != -1 && base > lastBlock)
+    {
+        complete(transferSize);
+        return;
+    }
+    progress.update(static_cast<size_t>(base - 1) * blocksize, transferSize);
+    fillWindow();
+    rearm();
+}
+
+void WriteSession::acceptReply(const PacketView &packet)
+{
+    // Server either acknowledges our options (OACK) or ignores them and acknowledges block 0
+    if (!applyOACK(packet))
+    {
+        if (packet.is(Opcode::ERROR))
+        {
+            throwServerError(packet);
+        }
+        else if (!packet.is(Opcode::ACK) || packet.blockNumber() != 0)
+        {
+            throw TransferException(TransferError::Protocol, "Server did not acknowledge the write request.");
+        }
+        logInfo() << "Server does not support options. Falling back to " << DEFAULT_BLOCK_SIZE << " bytes blocks without windowing";
+        blocksize = DEFAULT_BLOCK_SIZE;
+        windowsize = 1;
+    }
+    tftp.roundTrip().answered();
+    requesting = false;
+    window.resize(static_cast<size_t>(blocksize) * windowsize);
+    if (tftp.netascii())
+    {
+        unencoded.resize(blocksize);
+    }
+    lengths.resize(windowsize);
+    blocks = std::make_unique<OutgoingBatch>(windowsize);
+}
+
+void WriteSession::acceptACK(const PacketView &packet)
+{
+    if (packet.is(Opcode::ERROR))
+    {
+        throwServerError(packet);
+    }
+    if (!packet.is(Opcode::ACK))
+    {
+        printError("Warning: Received packet which supposet to be ACK packet with unusual opcode");
+        return;
+    }
+    long ackedBlock = tftp.blockNumber(packet.blockNumber(), base - 1);
+    logEvent(LogLevel::Debug, LogEvent::AckReceived, ackedBlock);
+
+    if (ackedBlock >= base && ackedBlock < next)
+    {
+        // Slide the window
+        base = ackedBlock + 1;
+        tftp.roundTrip().answered();
+    }
+    else if (ackedBlock == base - 1 && windowsize > 1 && resentFrom != base)
+    {
+        // The server lost a block (or timed out) and acknowledged the last one it got in order.
+        // Only the first such ACK resends the window: repeating it for every duplicate would answer
+        // duplicates with more duplicates (Sorcerer's Apprentice, RFC 1123 4.2.3.1). In lock-step
+        // a duplicate ACK means nothing was lost, recovery is left to the retransmission timeout
+        logEvent(LogLevel::Debug, LogEvent::WindowResent, base);
+        resentFrom = base;
+        resendWindow();
+    }
+}
+
+void WriteSession::fillWindow()
+{
+    while (next < base + windowsize && (lastBlock == -1 || next <= lastBlock))
+    {
+        char *slot = window.data() + ((next - 1) % windowsize) * blocksize;
+        int length = readBlock(slot);
+        lengths[(next - 1) % windowsize] = length;
+        if (length < blocksize)
+        {
+            lastBlock = next;
+        }
+        tftp.queue(*blocks, next, slot, length);
+        logEvent(LogLevel::Debug, LogEvent::BlockSent, length, next);
+        next++;
+    }
+    if (blocks->count != 0)
+    {
+        tftp.roundTrip().sent();
+        connection.sendBatch(*blocks);
+    }
+}
+
+int WriteSession::readBlock(char *block)
+{
+    if (!tftp.netascii())
+    {
+        return source->read(block, blocksize);
+    }
+    // Encoded data fill whole blocks, what does not fit waits for the next block
+    size_t filled = 0;
+    while (filled < static_cast<size_t>(blocksize))
+    {
+        if (unencodedStart == unencodedEnd && !sourceEnded)
+        {
+            unencodedEnd = source->read(unencoded.data(), blocksize);
+            unencodedStart = 0;
+            sourceEnded = unencodedEnd < static_cast<size_t>(blocksize);
+        }
+        size_t consumed;
+        filled += encoder.encode(unencoded.data() + unencodedStart, unencodedEnd - unencodedStart, block + filled, blocksize - filled, consumed);
+        unencodedStart += consumed;
+        if (sourceEnded && unencodedStart == unencodedEnd && !encoder.pending())
+        {
+            break;
+        }
+    }
+    return filled;
+}
+
+void WriteSession::resendWindow()
+{
+    for (long block = base; block < next; block++)
+    {
+        tftp.queue(*blocks, block, window.data() + ((block - 1) % windowsize) * blocksize, lengths[(block - 1) % windowsize]);
+    }
+    tftp.roundTrip().sent(true);
+    connection.sendBatch(*blocks);
+}
+
+void WriteSession::expired()
+{
+    if (!tftp.roundTrip().backoff())
+    {
+        throw TimeoutException();
+    }
+    if (requesting)
+    {
+        logInfo() << "Timeout. Sending write file request again.";
+        tftp.sendWRQ(connection, options.filePath, options.mode, blockSizeOffer, transferSize, options.timeoutOffer, options.windowSizeOffer);
+        tftp.roundTrip().sent(true);
+    }
+    else
+    {
+        printError("Timeout. Sending blocks from " + std::to_string(base) + " again.");
+        resendWindow();
+    }
+    rearm();
+}
+
+void WriteSession::release()
+{
+    ownedSource.reset();
+    source = nullptr;
+    std::vector<char>().swap(window);
+    blocks.reset();
+    replies.reset();
+    Session::release();
+}
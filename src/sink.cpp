@@ -0,0 +1,146 @@
+#include "sink.hpp"
+#include "udp.hpp"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#define MIN_MAPPING_GROWTH (1 << 20)
+
+MappedFileSink::MappedFileSink(std::string path)
+{
+    if ((fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1)
+    {
+        throw TransferException(TransferError::LocalFile, "Cannot open file " + path + " for writing: " + strerror(errno));
+    }
+}
+
+MappedFileSink::~MappedFileSink()
+{
+    if (mapping != nullptr)
+    {
+        munmap(mapping, mappedLength);
+    }
+    if (fd != -1)
+    {
+        // The transfer failed. Space reserved for the rest of the file is released, errors cannot be reported any more
+        ftruncate(fd, writtenEnd);
+        ::close(fd);
+    }
+}
+
+bool MappedFileSink::preallocate(size_t length)
+{
+    if (fallocate(fd, 0, 0, length) == -1)
+    {
+        if (errno == ENOSPC)
+        {
+            return false;
+        }
+        if (errno != EOPNOTSUPP)
+        {
+            throw TransferException(TransferError::LocalFile, std::string("Cannot allocate space for the file: ") + strerror(errno));
+        }
+        // File system cannot reserve blocks, the file will be sparse
+        if (ftruncate(fd, length) == -1)
+        {
+            throw TransferException(TransferError::LocalFile, std::string("Cannot resize the file: ") + strerror(errno));
+        }
+    }
+    expectedLength = length;
+    reserve(length);
+    return true;
+}
+
+void MappedFileSink::reserve(size_t end)
+{
+    if (end <= mappedLength)
+    {
+        return;
+    }
+    // Size from tsize is exact, otherwise grow geometrically to keep the number of remaps low
+    size_t newLength = expectedLength != 0 ? end : std::max(end, std::max(mappedLength * 2, static_cast<size_t>(MIN_MAPPING_GROWTH)));
+    if (newLength > expectedLength)
+    {
+        // Allocate the blocks now. Writing to a sparse mapping on a full disk would end with SIGBUS
+        if (fallocate(fd, 0, mappedLength, newLength - mappedLength) == -1)
+        {
+            if (errno == ENOSPC)
+            {
+                throw TransferException(TransferError::DiskFull, "Not enough free space on disk");
+            }
+            if (errno != EOPNOTSUPP || ftruncate(fd, newLength) == -1)
+            {
+                throw TransferException(TransferError::LocalFile, std::string("Cannot resize the file: ") + strerror(errno));
+            }
+        }
+    }
+
+    void *newMapping;
+    if (mapping == nullptr)
+    {
+        newMapping = mmap(nullptr, newLength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    else
+    {
+        newMapping = mremap(mapping, mappedLength, newLength, MREMAP_MAYMOVE);
+    }
+    if (newMapping == MAP_FAILED)
+    {
+        throw TransferException(TransferError::LocalFile, std::string("Cannot map the file: ") + strerror(errno));
+    }
+    mapping = static_cast<char *>(newMapping);
+    mappedLength = newLength;
+}
+
+char *MappedFileSink::map(size_t offset, size_t end)
+{
+    reserve(end);
+    return at(offset);
+}
+
+void MappedFileSink::write(size_t offset, const char *data, size_t length)
+{
+    reserve(offset + length);
+    writtenEnd = std::max(writtenEnd, offset + length);
+    if (data != at(offset))
+    {
+        memmove(at(offset), data, length);
+    }
+}
+
+void MappedFileSink::close(size_t length)
+{
+    if (mapping != nullptr)
+    {
+        munmap(mapping, mappedLength);
+        mapping = nullptr;
+    }
+    // Cut off the space reserved for a file of unknown size
+    if (ftruncate(fd, length) == -1)
+    {
+        throw TransferException(TransferError::LocalFile, std::string("Cannot resize the file: ") + strerror(errno));
+    }
+    ::close(fd);
+    fd = -1;
+}
+
+FileSource::FileSource(std::string path)
+{
+    struct stat stat_buf;
+    file.open(path, std::ios::binary);
+    if (stat(path.c_str(), &stat_buf) == -1 || !file)
+    {
+        throw TransferException(TransferError::LocalFile, "Cannot open file " + path + " for reading.");
+    }
+    length = stat_buf.st_size;
+}
+
+int FileSource::read(char *buffer, int length)
+{
+    file.read(buffer, length);
+    return file.gcount();
+}
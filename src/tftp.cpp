@@ -1,203 +1,231 @@
 #include "tftp.hpp"
 #include "udp.hpp"
+#include <arpa/inet.h>
+#include <charconv>
 #include <cstring>
-#include <sstream>
-#include <iomanip>
-
-void writeOptions(std::ostringstream &ss, int blockSize, int transferSize, int timeoutOffer);
-void writeOption(std::ostringstream &ss, int option, std::string name);
-
-std::string TFTP::blockNumberToStr(int blockNumber)
-{
-    std::stringstream ss;
-    ss << std::setw(2) << std::setfill('0') << blockNumber;
-    std::string s = ss.str();
-    return s;
-}
-
-// https://github.com/reinerh/rtftp/blob/trunk/src/lib.rs
-int TFTP::netasciiToOctet(char *buffer, int length, bool &previous_cr)
-{
-    int resultLength = 0;
-    for (int i = 0; i < length; i++)
-    {
-        auto b = buffer[i];
-        switch (b)
-        {
-        case '\r':
-            if (previous_cr)
-            {
-                buffer[i] = '\r';
-                resultLength++;
-            }
-            previous_cr = true;
-            continue;
-
-        case '\0':
-            if (previous_cr)
-            {
-                buffer[i] = '\r';
-                resultLength++;
-            }
-            break;
-        case '\n':
-            if (previous_cr)
-            {
-                buffer[i] = '\n';
-                resultLength++;
-            }
-        default:
-            resultLength++;
-            break;
-        }
-
-        previous_cr = false;
-    }
-    return resultLength;
-}
-
-int TFTP::octetToNetascii(char *buffer, char *outputWithDoubleCapacity, int length)
-{
-    int resultLength = 0;
-    for (int i = 0; i < length; i++)
-    {
-        auto &out = outputWithDoubleCapacity[i];
-        switch (buffer[i])
-        {
-        case '\r':
-            out = '\r';
-            outputWithDoubleCapacity[++i] = '\0';
-            resultLength += 2;
-            break;
-
-        case '\n':
-            out = '\r';
-            outputWithDoubleCapacity[++i] = '\n';
-            resultLength += 2;
-            break;
-        default:
-            out = buffer[i];
-            resultLength++;
-            break;
-        }
-    }
-    return resultLength;
-}
-
-void writeOption(std::ostringstream &ss, int option, std::string name)
-{
-    ss << '\0';
-    ss.write(name.c_str(), name.length() + 1);
-    auto stringValue = std::to_string(option);
-    ss << stringValue;
-}
-
-void writeOptions(std::ostringstream &ss, int blockSize, int transferSize, int timeoutOffer)
-{
-    writeOption(ss, blockSize, "blksize");
-    if (timeoutOffer != 0)
+#include <algorithm>
+
+size_t putBytes(std::span<char> packet, size_t position, const char *bytes, size_t length);
+size_t putString(std::span<char> packet, size_t position, std::string_view text);
+size_t putNumber(std::span<char> packet, size_t position, long number);
+size_t putOption(std::span<char> packet, size_t position, std::string_view name, std::string_view value);
+size_t putOption(std::span<char> packet, size_t position, std::string_view name, long value);
+size_t putOptions(std::span<char> packet, size_t position, int blockSize, size_t transferSize, int timeoutOffer, int windowSize = 1, bool multicast = false, int rollover = 0);
+
+std::string TFTP::blockNumberToStr(uint64_t blockNumber)
+{
+    int wire = wireBlockNumber(blockNumber);
+    return {static_cast<char>(wire >> 8), static_cast<char>(wire & 0xff)};
+}
+
+int TFTP::wireBlockNumber(uint64_t blockNumber) const
+{
+    if (rollover == 0 || blockNumber <= 0xffff)
     {
-        writeOption(ss, timeoutOffer, "timeout");
+        return static_cast<int>(blockNumber & 0xffff);
     }
-    writeOption(ss, transferSize, "tsize");
+    // After the first round, numbers go 1..65535, so a round is one block shorter
+    return static_cast<int>((blockNumber - 1) % 0xffff + 1);
 }
 
-std::string TFTP::makeRRQ(std::string filename, std::string mode, int blockSize, int timeoutOffer)
+uint64_t TFTP::blockNumber(int wireBlockNumber, uint64_t near) const
 {
-    std::ostringstream ss;
-    ss << '\000' << '\001';
-    ss.write(filename.c_str(), filename.length() + 1); //Write also the null terminator
-    ss << mode;
+    if (rollover != 0 && wireBlockNumber == 0)
+    {
+        return 0; // Only the first round has block 0
+    }
+    int64_t round = rollover == 0 ? 0x10000 : 0xffff;
+    // Distance from the wire number of near, in the range -round/2..round/2
+    int64_t distance = (wireBlockNumber - this->wireBlockNumber(near)) % round;
+    if (distance < 0)
+    {
+        distance += round;
+    }
+    if (distance >= round / 2)
+    {
+        distance -= round;
+    }
+    if (distance < 0 && static_cast<uint64_t>(-distance) > near)
+    {
+        distance += round; // No block before the first one
+    }
+    return near + distance;
+}
 
-    if (mode == "ascii" || mode == "netascii")
+size_t putBytes(std::span<char> packet, size_t position, const char *bytes, size_t length)
+{
+    if (position + length > packet.size())
     {
-        this->asciiMode = true;
+        throw CustomException("Packet does not fit into " + std::to_string(packet.size()) + " bytes.");
     }
+    memcpy(packet.data() + position, bytes, length);
+    return position + length;
+}
+
+// Writes text with its terminating zero
+size_t putString(std::span<char> packet, size_t position, std::string_view text)
+{
+    position = putBytes(packet, position, text.data(), text.length());
+    return putBytes(packet, position, "", 1);
+}
+
+size_t putNumber(std::span<char> packet, size_t position, long number)
+{
+    char digits[24];
+    auto converted = std::to_chars(digits, digits + sizeof digits, number);
+    position = putBytes(packet, position, digits, converted.ptr - digits);
+    return putBytes(packet, position, "", 1);
+}
 
-    writeOptions(ss, blockSize, 0, timeoutOffer);
+size_t putOption(std::span<char> packet, size_t position, std::string_view name, std::string_view value)
+{
+    return putString(packet, putString(packet, position, name), value);
+}
 
-    return ss.str();
+size_t putOption(std::span<char> packet, size_t position, std::string_view name, long value)
+{
+    return putNumber(packet, putString(packet, position, name), value);
 }
 
-int TFTP::sendRRQ(UDP &connection, std::string filename, std::string mode, int blockSize, int timeoutOffer)
+size_t putOptions(std::span<char> packet, size_t position, int blockSize, size_t transferSize, int timeoutOffer, int windowSize, bool multicast, int rollover)
 {
-    if (timeoutOffer == 0)
+    position = putOption(packet, position, "blksize", blockSize);
+    if (timeoutOffer != 0)
+    {
+        position = putOption(packet, position, "timeout", timeoutOffer);
+    }
+    if (windowSize > 1)
+    {
+        position = putOption(packet, position, "windowsize", windowSize);
+    }
+    if (multicast)
     {
-        return connection.send(makeRRQ(filename, mode, blockSize, timeoutOffer));
+        position = putOption(packet, position, "multicast", ""); // The value is always empty in requests (RFC 2090)
     }
-    return connection.sendWithTimeout(makeRRQ(filename, mode, blockSize, timeoutOffer), timeoutOffer);
+    if (rollover != 0)
+    {
+        position = putOption(packet, position, "rollover", rollover);
+    }
+    return putOption(packet, position, "tsize", static_cast<long>(transferSize));
 }
 
-std::string TFTP::makeWRQ(std::string filename, std::string mode, int blockSize, int transferSize, int timeoutOffer)
+std::span<char> TFTP::writeRRQ(std::span<char> packet, std::string_view filename, std::string_view mode, int blockSize, int timeoutOffer, int windowSize, bool multicast)
 {
-    std::ostringstream ss;
-    ss << '\000' << '\002';
-    ss.write(filename.c_str(), filename.length() + 1);
-    ss << mode;
+    size_t position = putBytes(packet, 0, "\0\1", 2);
+    position = putString(packet, position, filename);
+    position = putString(packet, position, mode);
 
     if (mode == "ascii" || mode == "netascii")
     {
         this->asciiMode = true;
     }
 
-    writeOptions(ss, blockSize, transferSize, timeoutOffer);
-
-    return ss.str();
+    position = putOptions(packet, position, blockSize, 0, timeoutOffer, windowSize, multicast, rollover);
+    return packet.first(position);
 }
 
-int TFTP::send(UDP &connection, int blockNumber, char *data, int length)
+std::span<char> TFTP::writeWRQ(std::span<char> packet, std::string_view filename, std::string_view mode, int blockSize, size_t transferSize, int timeoutOffer, int windowSize)
 {
-    std::ostringstream ss;
-    auto bn = blockNumberToStr(blockNumber);
-    ss << "\000\003"; //opcode
-    ss.write(bn.c_str(), 2);
-    if (this->asciiMode)
+    size_t position = putBytes(packet, 0, "\0\2", 2);
+    position = putString(packet, position, filename);
+    position = putString(packet, position, mode);
+
+    if (mode == "ascii" || mode == "netascii")
     {
-        char *outData = new char[length * 2];
-        int outDataLength = octetToNetascii(data, outData, length);
-        ss.write(outData, outDataLength);
-        delete[] outData;
+        this->asciiMode = true;
     }
-    else
+
+    position = putOptions(packet, position, blockSize, transferSize, timeoutOffer, windowSize, false, rollover);
+    return packet.first(position);
+}
+
+std::span<char> TFTP::writeACK(std::span<char> packet, int blockNumber)
+{
+    if (packet.size() < 4)
     {
-        ss.write(data, length);
+        throw CustomException("Packet does not fit into " + std::to_string(packet.size()) + " bytes.");
     }
+    // Opcode and the big-endian block number in one store
+    uint32_t ack = htonl(0x00040000u | static_cast<uint32_t>(blockNumber & 0xffff));
+    memcpy(packet.data(), &ack, 4);
+    return packet.first(4);
+}
 
-    if (this->timeout == 0)
+std::span<char> TFTP::writeDATAHeader(std::span<char> packet, int blockNumber)
+{
+    if (packet.size() < 4)
     {
-        return connection.send(ss.str());
+        throw CustomException("Packet does not fit into " + std::to_string(packet.size()) + " bytes.");
     }
-    return connection.sendWithTimeout(ss.str(), timeout);
+    uint32_t header = htonl(0x00030000u | static_cast<uint32_t>(blockNumber & 0xffff));
+    memcpy(packet.data(), &header, 4);
+    return packet.first(4);
 }
 
-std::string TFTP::makeACK(std::string block)
+std::span<char> TFTP::writeERROR(std::span<char> packet, int errorCode, std::string_view message)
 {
-    std::ostringstream ss;
-    ss << '\000' << '\004';
-    ss.write(block.c_str(), 2);
-    std::string str = ss.str();
-    return str;
+    char header[4] = {0, 5, static_cast<char>((errorCode >> 8) & 0xff), static_cast<char>(errorCode & 0xff)};
+    size_t position = putBytes(packet, 0, header, sizeof header);
+    position = putString(packet, position, message);
+    return packet.first(position);
 }
 
-int TFTP::receive(UDP &connection, char *buffer, int maxLength, int& networkRecvBytes)//Returns number of bytes in the converted message
+int TFTP::sendRRQ(UDP &connection, std::string_view filename, std::string_view mode, int blockSize, int timeoutOffer, int windowSize, bool multicast)
 {
-    if (this->timeout == 0)
-    {
-        networkRecvBytes = connection.receive(buffer, maxLength);
-    }
-    else
+    // Nothing to wait for before the request is sent, so the timeout applies only to the replies
+    auto request = writeRRQ(packet, filename, mode, blockSize, timeoutOffer, windowSize, multicast);
+    return connection.send(request.data(), request.size());
+}
+
+int TFTP::sendWRQ(UDP &connection, std::string_view filename, std::string_view mode, int blockSize, size_t transferSize, int timeoutOffer, int windowSize)
+{
+    auto request = writeWRQ(packet, filename, mode, blockSize, transferSize, timeoutOffer, windowSize);
+    return connection.send(request.data(), request.size());
+}
+
+void TFTP::queue(OutgoingBatch &batch, uint64_t blockNumber, const char *data, int length)
+{
+    char header[4];
+    batch.add(header, writeDATAHeader(header, wireBlockNumber(blockNumber)).size(), data, length);
+}
+
+void TFTP::queueACK(OutgoingBatch &batch, uint64_t blockNumber)
+{
+    char ack[4];
+    batch.add(ack, writeACK(ack, wireBlockNumber(blockNumber)).size());
+}
+
+int TFTP::sendACK(UDP &connection, uint64_t blockNumber)
+{
+    char ack[4];
+    return connection.send(ack, writeACK(ack, wireBlockNumber(blockNumber)).size());
+}
+
+int TFTP::sendERROR(UDP &connection, int errorCode, std::string_view message)
+{
+    auto error = writeERROR(packet, errorCode, message);
+    return connection.send(error.data(), error.size());
+}
+
+void TFTP::setTimeout(int seconds)
+{
+    // Capped in the estimator, so the give-up budget counts the timeouts really waited
+    if (seconds != 0)
     {
-        networkRecvBytes = connection.receiveWithTimeout(buffer, maxLength, timeout);
+        rtt.maximum = std::min<std::chrono::microseconds>(rtt.maximum, std::chrono::seconds(seconds));
     }
+}
+
+std::chrono::microseconds TFTP::retransmitTimeout()
+{
+    return rtt.timeout();
+}
 
+std::span<char> TFTP::decodePayload(char *payload, int payloadLength, bool last)//Applies transfer mode to a DATA packet payload
+{
     if (this->asciiMode)
     {
-        bool netasciiState = false;
-        int resultLength = netasciiToOctet(buffer + 4, networkRecvBytes - 4, netasciiState);
-        return resultLength;
-    }
-    else
-    {
-        return networkRecvBytes;
+        return decoder.decode(payload, payloadLength, last);
     }
-}
\ No newline at end of file
+    return {payload, static_cast<size_t>(payloadLength)};
+}
@@ -0,0 +1,15 @@
+#include "tftpclient.hpp"
+#include "eventloop.hpp"
+
+TransferSession::TransferSession(TransferOptions options) : options(options)
+{
+}
+
+TransferResult TransferSession::run()
+{
+    std::vector<std::unique_ptr<Session>> sessions;
+    sessions.push_back(Session::create(options));
+    EventLoop loop;
+    loop.run(sessions, 1);
+    return sessions[0]->result();
+}
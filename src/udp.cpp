@@ -2,6 +2,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <netinet/in.h>
 #include <net/if.h>
@@ -13,16 +14,20 @@
 
 int UDP::send(std::string s)
 {
-    return send(s.c_str(), (s.length() + 1)); //also send the null terminator
+    return send(s.c_str(), s.length());
 }
 int UDP::send(const char *sentData, std::size_t length)
 {
     int sentBytes;
     if ((sentBytes = sendto(sockFd, sentData, length, 0, endpoint->ai_addr, endpoint->ai_addrlen)) == -1)
     {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return 0; // Lost like on the network, retransmission recovers it
+        }
         throw UDPException(errno, " encountered while sending to server.");
     }
-
+    datagramsSent++;
     return sentBytes;
 }
 
@@ -33,7 +38,61 @@ int UDP::sendWithTimeout(const char *sentData, std::size_t length, int timeout)
 }
 int UDP::sendWithTimeout(std::string s, int timeout)
 {
-    return sendWithTimeout(s.c_str(), (s.length() + 1), timeout); //also send the null terminator
+    return sendWithTimeout(s.c_str(), s.length(), timeout);
+}
+
+OutgoingBatch::OutgoingBatch(int capacity)
+    : headerStorage(static_cast<size_t>(capacity) * MAX_BATCH_HEADER), headers(capacity), vectors(static_cast<size_t>(capacity) * 2)
+{
+    memset(headers.data(), 0, sizeof(struct mmsghdr) * capacity);
+    for (int i = 0; i < capacity; i++)
+    {
+        headers[i].msg_hdr.msg_iov = &vectors[i * 2];
+        vectors[i * 2].iov_base = headerStorage.data() + i * MAX_BATCH_HEADER;
+    }
+}
+
+void OutgoingBatch::add(const char *header, int headerLength, const char *payload, int payloadLength)
+{
+    if (full() || headerLength > MAX_BATCH_HEADER)
+    {
+        throw CustomException("Datagram does not fit into the outgoing batch");
+    }
+    auto vector = headers[count].msg_hdr.msg_iov;
+    memcpy(vector[0].iov_base, header, headerLength);
+    vector[0].iov_len = headerLength;
+    vector[1].iov_base = const_cast<char *>(payload);
+    vector[1].iov_len = payloadLength;
+    headers[count].msg_hdr.msg_iovlen = payloadLength > 0 ? 2 : 1;
+    count++;
+}
+
+int UDP::sendBatch(OutgoingBatch &batch)
+{
+    for (int i = 0; i < batch.count; i++)
+    {
+        batch.headers[i].msg_hdr.msg_name = endpoint->ai_addr;
+        batch.headers[i].msg_hdr.msg_namelen = endpoint->ai_addrlen;
+    }
+    int sent = 0;
+    while (sent < batch.count)
+    {
+        // The kernel may take only a part of the batch
+        int n = sendmmsg(sockFd, batch.headers.data() + sent, batch.count - sent, 0);
+        if (n == -1)
+        {
+            batch.count = 0;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return sent;
+            }
+            throw UDPException(errno, " encountered while sending to server.");
+        }
+        sent += n;
+        datagramsSent += n;
+    }
+    batch.count = 0;
+    return sent;
 }
 
 int UDP::receive(char *buffer, int maxLength)
@@ -43,10 +102,86 @@ int UDP::receive(char *buffer, int maxLength)
     {
         throw UDPException(errno, "encountered while receiving from server.");
     }
+    datagramsReceived++;
     return receivedBytes;
 }
 
+DatagramBatch::DatagramBatch(int capacity, int datagramSize)
+    : datagramSize(datagramSize), storage(static_cast<size_t>(capacity) * datagramSize), headers(capacity), vectors(static_cast<size_t>(capacity) * 2), sources(capacity)
+{
+    memset(headers.data(), 0, sizeof(struct mmsghdr) * capacity);
+    for (int i = 0; i < capacity; i++)
+    {
+        headers[i].msg_hdr.msg_iov = &vectors[i * 2];
+        headers[i].msg_hdr.msg_name = &sources[i];
+        untarget(i);
+    }
+}
+
+void DatagramBatch::target(int index, char *payload, int maxLength)
+{
+    vectors[index * 2].iov_base = datagram(index);
+    vectors[index * 2].iov_len = 4;
+    vectors[index * 2 + 1].iov_base = payload;
+    vectors[index * 2 + 1].iov_len = maxLength;
+    headers[index].msg_hdr.msg_iovlen = 2;
+}
+
+void DatagramBatch::untarget(int index)
+{
+    vectors[index * 2].iov_base = datagram(index);
+    vectors[index * 2].iov_len = datagramSize;
+    headers[index].msg_hdr.msg_iovlen = 1;
+}
+
+int UDP::receiveBatch(DatagramBatch &batch, std::chrono::microseconds timeout)
+{
+    if (timeout.count() != 0)
+    {
+        createTimeout(timeout);
+    }
+    return receiveMessages(batch, MSG_WAITFORONE);
+}
+
+int UDP::receiveAvailable(DatagramBatch &batch)
+{
+    return receiveMessages(batch, MSG_DONTWAIT);
+}
+
+int UDP::receiveMessages(DatagramBatch &batch, int flags)
+{
+    for (auto &header : batch.headers)
+    {
+        header.msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+    }
+    int received;
+    if ((received = recvmmsg(sockFd, batch.headers.data(), batch.headers.size(), flags, NULL)) == -1)
+    {
+        batch.count = 0;
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return 0;
+        }
+        throw UDPException(errno, "encountered while receiving from server.");
+    }
+    // Reply to wherever the server answered from, as receive() does
+    auto &lastHeader = batch.headers[received - 1].msg_hdr;
+    if (lastHeader.msg_namelen <= endpoint->ai_addrlen)
+    {
+        memcpy(endpoint->ai_addr, lastHeader.msg_name, lastHeader.msg_namelen);
+        endpoint->ai_addrlen = lastHeader.msg_namelen;
+    }
+    batch.count = received;
+    datagramsReceived += received;
+    return received;
+}
+
 void UDP::createTimeout(int timeout)
+{
+    createTimeout(std::chrono::seconds(timeout));
+}
+
+void UDP::createTimeout(std::chrono::microseconds timeout)
 {
     fd_set fds;
     int n;
@@ -57,14 +192,14 @@ void UDP::createTimeout(int timeout)
     FD_SET(sockFd, &fds);
 
     // set up the struct timeval for the timeout
-    tv.tv_sec = timeout;
-    tv.tv_usec = 0;
+    tv.tv_sec = timeout.count() / 1000000;
+    tv.tv_usec = timeout.count() % 1000000;
 
     // wait until timeout or data received
-    n = select(sockFd + 1, &fds, NULL, NULL, &tv);
+    n = select(sockFd + 1, &fds, NULL, NULL, timeout.count() == 0 ? NULL : &tv);
     if (n == 0)
     {
-        throw UDPException(0, "Timeout!");
+        throw TimeoutException();
     }
     else if (n == -1)
     {
@@ -78,6 +213,12 @@ int UDP::receiveWithTimeout(char *buffer, int maxLength, int timeout)
     return receive(buffer, maxLength);
 }
 
+int UDP::receiveWithTimeout(char *buffer, int maxLength, std::chrono::microseconds timeout)
+{
+    createTimeout(timeout);
+    return receive(buffer, maxLength);
+}
+
 int UDP::createSocket(std::string server, int port)
 {
     struct addrinfo hints, *servinfo;
@@ -92,6 +233,8 @@ int UDP::createSocket(std::string server, int port)
         throw UDPException(errno, gai_strerror(returnValue));
     }
 
+    freeAddresses();
+    addresses = servinfo;
     // loop through all the results and make a socket
     for (endpoint = servinfo; endpoint != NULL; endpoint = endpoint->ai_next)
     {
@@ -113,6 +256,104 @@ int UDP::createSocket(std::string server, int port)
     return sockFd;
 }
 
+int UDP::createMulticastSocket(std::string group, int port)
+{
+    struct addrinfo hints, *groupinfo;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICHOST;
+    int returnValue;
+    if ((returnValue = getaddrinfo(group.c_str(), std::to_string(port).c_str(), &hints, &groupinfo)) != 0)
+    {
+        throw UDPException(errno, gai_strerror(returnValue));
+    }
+    freeAddresses();
+    addresses = groupinfo;
+    endpoint = groupinfo;
+    if ((sockFd = socket(endpoint->ai_family, endpoint->ai_socktype, endpoint->ai_protocol)) == -1)
+    {
+        throw UDPException(errno, " encountered while creating multicast socket");
+    }
+    opened = true;
+
+    // More clients on the same machine can listen to the same group
+    int reuse = 1;
+    if (setsockopt(sockFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof reuse) == -1)
+    {
+        throw UDPException(errno, " encountered while setting SO_REUSEADDR");
+    }
+    // Binding to the group address filters out datagrams of other groups on the same port
+    if (bind(sockFd, endpoint->ai_addr, endpoint->ai_addrlen) == -1)
+    {
+        throw UDPException(errno, " encountered while binding multicast socket");
+    }
+
+    if (endpoint->ai_family == AF_INET)
+    {
+        ip_mreq membership;
+        membership.imr_multiaddr = reinterpret_cast<sockaddr_in *>(endpoint->ai_addr)->sin_addr;
+        membership.imr_interface.s_addr = htonl(INADDR_ANY);
+        returnValue = setsockopt(sockFd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof membership);
+    }
+    else
+    {
+        ipv6_mreq membership;
+        membership.ipv6mr_multiaddr = reinterpret_cast<sockaddr_in6 *>(endpoint->ai_addr)->sin6_addr;
+        membership.ipv6mr_interface = 0;
+        returnValue = setsockopt(sockFd, IPPROTO_IPV6, IPV6_JOIN_GROUP, &membership, sizeof membership);
+    }
+    if (returnValue == -1)
+    {
+        throw UDPException(errno, " encountered while joining multicast group " + group);
+    }
+    return sockFd;
+}
+
+int UDP::createServerSocket(std::string address, int port)
+{
+    createSocket(address, port);
+    if (bind(sockFd, endpoint->ai_addr, endpoint->ai_addrlen) == -1)
+    {
+        throw UDPException(errno, " encountered while binding socket to " + address);
+    }
+    return sockFd;
+}
+
+int UDP::localPort()
+{
+    struct sockaddr_storage local;
+    socklen_t length = sizeof local;
+    if (getsockname(sockFd, reinterpret_cast<struct sockaddr *>(&local), &length) == -1)
+    {
+        throw UDPException(errno, " encountered while reading the local address");
+    }
+    if (local.ss_family == AF_INET6)
+    {
+        return ntohs(reinterpret_cast<struct sockaddr_in6 *>(&local)->sin6_port);
+    }
+    return ntohs(reinterpret_cast<struct sockaddr_in *>(&local)->sin_port);
+}
+
+void UDP::replyTo(const UDP &other)
+{
+    if (other.endpoint->ai_addrlen > endpoint->ai_addrlen)
+    {
+        throw CustomException("Cannot reply to an address of another family");
+    }
+    memcpy(endpoint->ai_addr, other.endpoint->ai_addr, other.endpoint->ai_addrlen);
+    endpoint->ai_addrlen = other.endpoint->ai_addrlen;
+}
+
+void UDP::setNonBlocking()
+{
+    int flags = fcntl(sockFd, F_GETFL, 0);
+    if (flags == -1 || fcntl(sockFd, F_SETFL, flags | O_NONBLOCK) == -1)
+    {
+        throw UDPException(errno, " encountered while making the socket non-blocking");
+    }
+}
+
 int UDP::checkTimeout(char *receiveBuffer, int maxLength)
 {
     fd_set fds;
@@ -164,12 +405,23 @@ const auto &closeFd = close; //Rename the function
 int UDP::close()
 {
     opened = false;
+    freeAddresses();
     return closeFd(sockFd);
 }
 UDP::~UDP()
 {
     if (opened)
         close();
+    freeAddresses();
+}
+void UDP::freeAddresses()
+{
+    if (addresses != nullptr)
+    {
+        freeaddrinfo(addresses);
+        addresses = nullptr;
+        endpoint = nullptr;
+    }
 }
 UDPException::UDPException(int whichErrno, std::string additionalMessage)
 {
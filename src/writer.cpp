@@ -0,0 +1,125 @@
+#include "writer.hpp"
+#include "udp.hpp"
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+BackgroundWriter::BackgroundWriter(Sink &sink, int queuedBlocks, int blockSize)
+    : sink(sink), storage(static_cast<size_t>(queuedBlocks) * blockSize), filled(queuedBlocks + 1), free(queuedBlocks)
+{
+    if ((freedFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+    {
+        throw UDPException(errno, " encountered while creating eventfd");
+    }
+    for (int i = 0; i < queuedBlocks; i++)
+    {
+        free.push(storage.data() + static_cast<size_t>(i) * blockSize);
+    }
+    thread = std::thread(&BackgroundWriter::run, this);
+}
+
+BackgroundWriter::~BackgroundWriter()
+{
+    if (thread.joinable())
+    {
+        // A failed transfer must not wait until the disk takes all queued blocks
+        abandoned.store(true, std::memory_order_relaxed);
+        queue({nullptr, 0, 0});
+        thread.join();
+    }
+    ::close(freedFd);
+}
+
+void BackgroundWriter::queue(const QueuedBlock &block)
+{
+    // Never full, there is a place for every buffer and the stop marker
+    filled.push(block);
+    // Pairs with the fence in run(): either the writer sees the block or this sees it asleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (writerSleeping.load(std::memory_order_relaxed))
+    {
+        writerSleeping.store(false, std::memory_order_relaxed);
+        writerSleeping.notify_one();
+    }
+}
+
+void BackgroundWriter::run()
+{
+    QueuedBlock block;
+    while (true)
+    {
+        if (!filled.pop(block))
+        {
+            writerSleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!filled.pop(block))
+            {
+                writerSleeping.wait(true, std::memory_order_relaxed);
+                continue;
+            }
+            writerSleeping.store(false, std::memory_order_relaxed);
+        }
+        if (block.buffer == nullptr)
+        {
+            return; // Stop marker
+        }
+        if (!failed.load(std::memory_order_relaxed) && !abandoned.load(std::memory_order_relaxed))
+        {
+            try
+            {
+                sink.write(block.offset, block.buffer, block.length);
+            }
+            catch (...)
+            {
+                // Keep returning buffers, so the network loop does not wait forever
+                error = std::current_exception();
+                failed.store(true, std::memory_order_release);
+            }
+        }
+        free.push(block.buffer);
+        // Pairs with the fence in tryAcquire(), only a loop which ran out of buffers is signalled
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (networkWaiting.load(std::memory_order_relaxed) && networkWaiting.exchange(false, std::memory_order_relaxed))
+        {
+            eventfd_write(freedFd, 1); // Cannot fail, the loop reads the counter back to 0
+        }
+    }
+}
+
+void BackgroundWriter::checkError()
+{
+    if (failed.load(std::memory_order_acquire))
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+char *BackgroundWriter::tryAcquire()
+{
+    checkError();
+    char *buffer;
+    if (free.pop(buffer))
+    {
+        return buffer;
+    }
+    networkWaiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (free.pop(buffer))
+    {
+        networkWaiting.store(false, std::memory_order_relaxed);
+        return buffer;
+    }
+    return nullptr;
+}
+
+void BackgroundWriter::push(char *buffer, size_t offset, size_t length)
+{
+    checkError();
+    queue({buffer, offset, length});
+}
+
+void BackgroundWriter::finish()
+{
+    queue({nullptr, 0, 0});
+    thread.join();
+    checkError();
+}